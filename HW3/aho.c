@@ -0,0 +1,306 @@
+/**
+ * @author David Hines (dhhines)
+ * @file aho.c
+ *
+ * Implementation of the Aho-Corasick automaton (see aho.h).  The trie is built
+ * straight into the dense transition table; a breadth first pass then computes the
+ * failure links and fills every missing transition from the failure state, so the
+ * scan loop never has to follow a failure link.
+ */
+
+#include "aho.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+//initial capacity of the state arrays and the found list
+#define INIT_CPCTY 64
+//standard multiplier for increasing size of the arrays
+#define STD_INCRMT 2
+
+struct Automaton_Struct {
+    int numStates;
+    int numClasses;  //columns of the transition table
+    uint8_t classOf[256];  //column used for each byte
+    uint32_t *delta;  //numStates x numClasses transition table
+    uint32_t *depth;  //length of the string spelled by each state
+    int32_t *accept;  //pattern ending at each state, or -1
+    int numPatterns;
+    char **patterns;  //copies of the distinct patterns
+};
+
+/**
+ * Grows the state arrays so at least one more state fits.
+ *
+ * @param ac       the automaton being built
+ * @param capacity current capacity in states; updated when grown
+ */
+static void reserveState(Automaton *ac, int *capacity)
+{
+    if (ac->numStates < *capacity)
+        return;
+
+    *capacity *= STD_INCRMT;
+    ac->delta = (uint32_t *) realloc(ac->delta, (size_t) *capacity * ac->numClasses * sizeof(uint32_t));
+    ac->depth = (uint32_t *) realloc(ac->depth, *capacity * sizeof(uint32_t));
+    ac->accept = (int32_t *) realloc(ac->accept, *capacity * sizeof(int32_t));
+    if (!ac->delta || !ac->depth || !ac->accept)
+        exit(EXIT_FAILURE);
+}
+
+Automaton *buildAutomaton(char *const *patterns, int numPatterns)
+{
+    Automaton *ac = (Automaton *) calloc(1, sizeof(Automaton));
+    if (!ac)
+        exit(EXIT_FAILURE);
+
+    //give every byte used by a usable pattern its own column
+    ac->numClasses = 1;
+    for (int i = 0; i < numPatterns; i++){
+        size_t len = strlen(patterns[i]);
+        int usable = len > 0;
+        for (size_t j = 0; j < len; j++)
+            if (isDelim(patterns[i][j]))
+                usable = 0;
+        for (size_t j = 0; usable && j < len; j++){
+            uint8_t ch = (uint8_t) patterns[i][j];
+            if (!ac->classOf[ch])
+                ac->classOf[ch] = (uint8_t) ac->numClasses++;
+        }
+    }
+
+    int capacity = INIT_CPCTY;
+    ac->delta = (uint32_t *) malloc((size_t) capacity * ac->numClasses * sizeof(uint32_t));
+    ac->depth = (uint32_t *) malloc(capacity * sizeof(uint32_t));
+    ac->accept = (int32_t *) malloc(capacity * sizeof(int32_t));
+    ac->patterns = (char **) malloc((numPatterns > 0 ? numPatterns : 1) * sizeof(char *));
+    if (!ac->delta || !ac->depth || !ac->accept || !ac->patterns)
+        exit(EXIT_FAILURE);
+
+    //state 0 is the root
+    ac->numStates = 1;
+    memset(ac->delta, 0, ac->numClasses * sizeof(uint32_t));
+    ac->depth[0] = 0;
+    ac->accept[0] = -1;
+
+    //insert the patterns into the trie; a 0 entry means "no child" until the
+    //breadth first pass below since no state has the root as a child
+    for (int i = 0; i < numPatterns; i++){
+        const char *pat = patterns[i];
+        size_t len = strlen(pat);
+        uint32_t state = 0;
+        int usable = len > 0;
+
+        for (size_t j = 0; j < len; j++)
+            if (isDelim(pat[j]))
+                usable = 0;
+        if (!usable)
+            continue;
+
+        for (size_t j = 0; j < len; j++){
+            uint32_t *next = &ac->delta[(size_t) state * ac->numClasses + ac->classOf[(uint8_t) pat[j]]];
+            if (*next == 0){
+                reserveState(ac, &capacity);
+                //the table may have moved
+                next = &ac->delta[(size_t) state * ac->numClasses + ac->classOf[(uint8_t) pat[j]]];
+                uint32_t child = (uint32_t) ac->numStates++;
+                memset(&ac->delta[(size_t) child * ac->numClasses], 0, ac->numClasses * sizeof(uint32_t));
+                ac->depth[child] = ac->depth[state] + 1;
+                ac->accept[child] = -1;
+                *next = child;
+            }
+            state = *next;
+        }
+
+        if (ac->accept[state] < 0){
+            ac->accept[state] = ac->numPatterns;
+            ac->patterns[ac->numPatterns] = strdup(pat);
+            ac->numPatterns++;
+        }
+    }
+
+    //breadth first pass: compute the failure link of each state and replace its
+    //missing transitions with those of the failure state
+    uint32_t *queue = (uint32_t *) malloc(ac->numStates * sizeof(uint32_t));
+    uint32_t *fail = (uint32_t *) calloc(ac->numStates, sizeof(uint32_t));
+    if (!queue || !fail)
+        exit(EXIT_FAILURE);
+    int head = 0;
+    int tail = 0;
+
+    for (int c = 0; c < ac->numClasses; c++){
+        uint32_t child = ac->delta[c];
+        if (child){
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail){
+        uint32_t state = queue[head++];
+        uint32_t *row = &ac->delta[(size_t) state * ac->numClasses];
+        const uint32_t *failRow = &ac->delta[(size_t) fail[state] * ac->numClasses];
+
+        for (int c = 0; c < ac->numClasses; c++){
+            if (row[c]){
+                fail[row[c]] = failRow[c];
+                queue[tail++] = row[c];
+            }
+            else
+                row[c] = failRow[c];
+        }
+    }
+
+    free(queue);
+    free(fail);
+    return ac;
+}
+
+Automaton *loadAutomaton(const char *path)
+{
+    Source src;
+    if (openSource(&src, path) < 0 || !src.mapped){
+        if (src.data)
+            closeSource(&src);
+        return NULL;
+    }
+
+    int capacity = INIT_CPCTY;
+    int count = 0;
+    char **patterns = (char **) calloc(capacity, sizeof(char *));
+    if (!patterns)
+        exit(EXIT_FAILURE);
+
+    //collect the trimmed lines of the file
+    size_t pos = 0;
+    while (pos < src.size){
+        const char *nl = memchr(src.data + pos, '\n', src.size - pos);
+        size_t end = nl ? (size_t) (nl - src.data) : src.size;
+        size_t from = pos;
+        size_t to = end;
+
+        while (from < to && isDelim(src.data[from]))
+            from++;
+        while (to > from && isDelim(src.data[to - 1]))
+            to--;
+
+        if (to > from){
+            if (count == capacity){
+                char **grown = (char **) realloc(patterns, capacity * STD_INCRMT * sizeof(char *));
+                if (!grown)
+                    exit(EXIT_FAILURE);
+                patterns = grown;
+                capacity *= STD_INCRMT;
+            }
+            patterns[count] = strndup(src.data + from, to - from);
+            for (size_t i = from; i < to; i++)
+                if (isDelim(src.data[i])){
+                    fprintf(stderr, "Ignoring pattern with whitespace: %s\n", patterns[count]);
+                    break;
+                }
+            count++;
+        }
+        pos = end + 1;
+    }
+    closeSource(&src);
+
+    Automaton *ac = buildAutomaton(patterns, count);
+    for (int i = 0; i < count; i++)
+        free(patterns[i]);
+    free(patterns);
+
+    if (ac->numPatterns == 0){
+        freeAutomaton(ac);
+        return NULL;
+    }
+    return ac;
+}
+
+void freeAutomaton(Automaton *ac)
+{
+    for (int i = 0; i < ac->numPatterns; i++)
+        free(ac->patterns[i]);
+    free(ac->patterns);
+    free(ac->delta);
+    free(ac->depth);
+    free(ac->accept);
+    free(ac);
+}
+
+int numPatterns(const Automaton *ac)
+{
+    return ac->numPatterns;
+}
+
+const char *patternText(const Automaton *ac, int id)
+{
+    return ac->patterns[id];
+}
+
+long acScanLines(const Automaton *ac, const char *data, size_t size, size_t start, size_t end,
+                 off_t base, MatchFunc onMatch, void *ctx)
+{
+    const uint32_t *delta = ac->delta;
+    const int numClasses = ac->numClasses;
+    long found = 0;
+
+    //patterns found on the current line; seen[] holds 1 + the line number a
+    //pattern was last reported on so each pattern is listed once per line
+    int capacity = INIT_CPCTY;
+    int numIds = 0;
+    int *ids = (int *) malloc(capacity * sizeof(int));
+    long *seen = (long *) calloc(ac->numPatterns, sizeof(long));
+    if (!ids || !seen)
+        exit(EXIT_FAILURE);
+
+    size_t stop = lineStart(data, size, end);
+    size_t lineFrom = start;
+    long lineNum = 1;
+    uint32_t state = 0;
+    size_t tokLen = 0;
+
+    for (size_t i = start; i <= stop; i++){
+        //the end of the block acts as a final delimiter
+        char ch = i < stop ? data[i] : '\n';
+
+        if (!isDelim(ch)){
+            state = delta[(size_t) state * numClasses + ac->classOf[(uint8_t) ch]];
+            tokLen++;
+            continue;
+        }
+
+        //a token equals a pattern when the automaton spelled the whole token
+        if (tokLen > 0 && ac->accept[state] >= 0 && ac->depth[state] == tokLen){
+            int id = ac->accept[state];
+            if (seen[id] != lineNum){
+                seen[id] = lineNum;
+                if (numIds == capacity){
+                    capacity *= STD_INCRMT;
+                    ids = (int *) realloc(ids, capacity * sizeof(int));
+                    if (!ids)
+                        exit(EXIT_FAILURE);
+                }
+                ids[numIds++] = id;
+            }
+        }
+        state = 0;
+        tokLen = 0;
+
+        if (ch == '\n'){
+            if (numIds > 0 && lineFrom < stop){
+                size_t to = i < size ? i : size;
+                Slice line = { base + (off_t) lineFrom, to - lineFrom };
+                onMatch(data + lineFrom, line, ids, numIds, ctx);
+                found++;
+            }
+            numIds = 0;
+            lineNum++;
+            lineFrom = i + 1;
+        }
+    }
+
+    free(ids);
+    free(seen);
+    return found;
+}
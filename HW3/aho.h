@@ -0,0 +1,76 @@
+/**
+ * @author David Hines (dhhines)
+ * @file aho.h
+ *
+ * Aho-Corasick automaton for searching many words in one pass.  The patterns are
+ * compiled once into a dense DFA (goto and failure functions folded together) over
+ * a compressed alphabet: every byte that appears in some pattern gets its own
+ * column and all other bytes share column 0, so the transition table stays small
+ * enough to live in cache even for hundreds of patterns.
+ *
+ * Matching keeps the whole-word semantics of the single word search: a pattern is
+ * reported when a token of the line is exactly equal to it, and the cost per byte
+ * is one table lookup no matter how many patterns there are.
+ */
+
+#ifndef AHO_H
+#define AHO_H
+
+#include "scan.h"
+
+/**
+ * Builds an automaton over the given patterns.  Duplicate patterns share an id;
+ * empty patterns and patterns containing a delimiter can never equal a token and
+ * are ignored.
+ *
+ * @param patterns    array of pattern strings
+ * @param numPatterns number of strings in the array
+ * @return the new automaton
+ */
+Automaton *buildAutomaton(char *const *patterns, int numPatterns);
+
+/**
+ * Reads a pattern list file (one pattern per line, surrounding whitespace ignored)
+ * and builds an automaton over it.
+ *
+ * @param path name of the pattern list file
+ * @return the new automaton, or NULL if the file can't be read or holds no patterns
+ */
+Automaton *loadAutomaton(const char *path);
+
+/**
+ * Frees the automaton and its copies of the patterns.
+ *
+ * @param ac the automaton to free
+ */
+void freeAutomaton(Automaton *ac);
+
+/**
+ * Returns the number of distinct patterns in the automaton.
+ *
+ * @param ac the automaton
+ * @return number of patterns
+ */
+int numPatterns(const Automaton *ac);
+
+/**
+ * Returns the text of a pattern.
+ *
+ * @param ac the automaton
+ * @param id pattern id reported to a MatchFunc
+ * @return the pattern text
+ */
+const char *patternText(const Automaton *ac, int id);
+
+/**
+ * Scans the lines that start within [start, end) of the buffer with the automaton,
+ * calling onMatch once per matching line with every distinct pattern found on it
+ * (in order of first occurrence).  See scanLines for the meaning of the other
+ * parameters.
+ *
+ * @return number of matching lines
+ */
+long acScanLines(const Automaton *ac, const char *data, size_t size, size_t start, size_t end,
+                 off_t base, MatchFunc onMatch, void *ctx);
+
+#endif
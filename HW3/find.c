@@ -3,115 +3,543 @@
  * @file find.c
  *
  * Program to search files provided on the command line for the provided word.
- * Each file provided will be searched using a separate process.  When the word
- * is found in the provided text files this program will print the word, the line
- * of text in which the word was found and the process ID of the process that
- * performed the search function.
+ * The files are searched by a pool of worker processes that is forked once at
+ * startup, so a file that crashes the search only takes down one worker.  Large
+ * files are split into byte ranges aligned on line boundaries and the parent hands
+ * the ranges out over a pipe to each worker, one at a time.  When the word is
+ * found in the provided text files this program will print the word, the line of
+ * text in which the word was found and the process ID of the process that
+ * performed the search function.  With -f the words to find are read from a
+ * pattern list file (one per line) and every pattern found on a line is printed
+ * with it.
  *
- * Compile commands: gcc -Wall -g -std=c99 find.c -o find *
+ * Workers never write to the console themselves: each sends its lines in batches
+ * through a lock-free ring in shared memory (see ring.h) and pokes the parent
+ * through a pipe.  The parent is the only writer and puts the lines out in file
+ * order.  Every worker is reaped; one that dies is reported along with the file it
+ * was searching and replaced by a new worker.  With -v the number of jobs, bytes
+ * searched and throughput of each worker are reported when it exits.  With -o json
+ * or -o binary the matches are written as NDJSON or binary records (see output.h).
+ *
+ * Compilation: use provided Makefile
+ *              -usage: "make find" or "make clean"
+ *
+ * Usage: ./find [options] <word> <file>... (use - to search standard input)
+ *        ./find [options] -f <pattern file> <file>...
+ *        options: -p processes, -o text|json|binary, -v
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include "scan.h"
+#include "aho.h"
+#include "output.h"
+#include "ring.h"
 
-//initial capacity of the line buffer
-#define INIT_CPCTY 10
-//standard multiplier for increasing size of line buffer
-#define STD_INCRMT 2
-//maximum word size
-#define MAX_BUFFER 200
-//number of possible processes
+//default number of worker processes
 #define NUM_PROCS 5
+//size of the byte ranges large files are split into
+#define CHUNK_SIZE (8 * 1024 * 1024)
+//bytes in each worker's result ring
+#define RING_SIZE (1024 * 1024)
+//largest message body sent through a ring
+#define MAX_MESSAGE (RING_SIZE / 4)
+//nanoseconds a worker sleeps while its ring is full
+#define RING_WAIT_NS 50000
+
+//kinds of message a worker sends
+#define MSG_DATA 0
+#define MSG_DONE 1
+
+//a unit of work: a byte range of one input file
+struct Task_Struct {
+    int seq;  //position of the task in the output order
+    int file;  //index of the file
+    long long start;  //first byte of the range
+    long long end;  //one past the last byte, or -1 for the whole file
+};
+
+typedef struct Task_Struct Task;
+
+//header of a message in a worker's ring
+struct Message_Struct {
+    int seq;  //task the message belongs to
+    int kind;  //MSG_DATA or MSG_DONE
+    uint32_t len;  //bytes in the body
+    uint32_t unused;
+};
+
+typedef struct Message_Struct Message;
+
+//body of a MSG_DONE message
+struct Stats_Struct {
+    uint64_t bytes;  //bytes searched
+    uint64_t nsec;  //time spent on the task
+    uint64_t failed;  //1 if the file couldn't be searched
+};
+
+typedef struct Stats_Struct Stats;
+
+//a worker process as seen by the parent
+struct Worker_Struct {
+    pid_t pid;  //0 once the worker has been retired
+    int taskFd;  //write end of the task pipe, -1 once closed
+    int notifyFd;  //read end of the notify pipe
+    Ring *ring;  //results sent by the worker
+    int seq;  //task being searched, -1 when idle
+    int jobs;  //tasks finished by this process
+    uint64_t bytes;  //bytes searched by this process
+    uint64_t nsec;  //time spent searching by this process
+};
+
+typedef struct Worker_Struct Worker;
+
+//output of one task held by the parent until it is that task's turn
+struct Pending_Struct {
+    Batch batch;
+    int done;
+};
+
+typedef struct Pending_Struct Pending;
+
+//state of the parent
+struct Search_Struct {
+    Query query;  //the word or patterns to search for
+    OutputFormat format;
+    char **files;  //names of the files to search
+    Task *tasks;
+    int numTasks;
+    int nextTask;  //next task to hand out
+    int *requeued;  //tasks handed back by workers that died before reading them
+    int numRequeued;
+    int head;  //task whose output is being written
+    Pending *pending;
+    Worker *workers;
+    int numWorkers;
+    int verbose;
+    int status;
+};
+
+typedef struct Search_Struct Search;
+
+//details written with each matching line
+struct Printer_Struct {
+    const Query *query;
+    const char *file;  //name of the file being searched
+    OutputFormat format;
+    int pid;
+    pid_t parent;  //pid of the parent, to notice when it has gone
+    int seq;  //task the lines belong to
+    Ring *ring;
+    int notifyFd;  //write end of the notify pipe
+    Batch batch;  //lines not yet sent
+};
+
+typedef struct Printer_Struct Printer;
 
 /**
- * This function reads a single line of input text from the file stream and then
- * returns the text as a string in a block of dynamically allocated memory.
+ * Sends one message through the worker's ring, waiting while the ring is full,
+ * then pokes the parent.  Exits if the parent has gone.
  *
- * @param *fp pointer to the input file stream to be parsed
- * @return pointer to the dynamic memory block holding the text of a single line
- *  from input file (or user command)
+ * @param prt  the worker's Printer
+ * @param kind MSG_DATA or MSG_DONE
+ * @param body the message body
+ * @param len  bytes in the body (at most MAX_MESSAGE)
  */
-char *readLine(FILE *fp)
+void sendMessage(Printer *prt, int kind, const void *body, size_t len)
 {
-    //create a resizeable array using malloc and realloc and a capacity integer
-    int capacity = INIT_CPCTY;
-    char *buffer = (char *) malloc (capacity * sizeof(char) + 1);
-    int len = 0;
-    char ch;
-    int matches = 0;
-
-    while ((matches = (fscanf(fp, "%c", &ch) == 1))){
-        if (len >= capacity){
-            capacity *= STD_INCRMT;
-            buffer = (char *) realloc (buffer, capacity * sizeof(char) + 1);
-            if (!buffer){
-                free(buffer);
-                exit(EXIT_FAILURE);
+    Message msg = { prt->seq, kind, (uint32_t) len, 0 };
+    struct timespec pause = { 0, RING_WAIT_NS };
+    char poke = 0;
+
+    while (ringPut(prt->ring, &msg, sizeof(msg), body, len) < 0){
+        if (getppid() != prt->parent)
+            _exit(EXIT_FAILURE);
+        nanosleep(&pause, NULL);
+    }
+
+    //a full notify pipe already has a poke the parent hasn't read
+    if (write(prt->notifyFd, &poke, 1) < 0 && errno != EAGAIN)
+        _exit(EXIT_FAILURE);
+}
+
+/**
+ * Sends the lines in the batch to the parent and empties it.
+ *
+ * @param prt the worker's Printer
+ */
+void flushBatch(Printer *prt)
+{
+    for (size_t sent = 0; sent < prt->batch.len; sent += MAX_MESSAGE){
+        size_t len = prt->batch.len - sent < MAX_MESSAGE ? prt->batch.len - sent : MAX_MESSAGE;
+        sendMessage(prt, MSG_DATA, prt->batch.data + sent, len);
+    }
+    prt->batch.len = 0;
+}
+
+/**
+ * Formats a single matching line into the batch along with the words found on it
+ * (comma separated) and the ID of the process that found it.  Full batches are
+ * sent to the parent.
+ *
+ * @param text   pointer to the first character of the matching line
+ * @param line   offset and length of the line in the file
+ * @param ids    ids of the words found on the line
+ * @param numIds number of ids
+ * @param ctx    pointer to the Printer
+ */
+void printMatch(const char *text, Slice line, const int *ids, int numIds, void *ctx)
+{
+    Printer *prt = (Printer *)ctx;
+    Record rec = { prt->file, "PID", "pid", prt->pid, prt->query, ids, numIds, text, line };
+
+    formatRecord(&prt->batch, prt->format, &rec);
+    if (prt->batch.len >= BATCH_SIZE)
+        flushBatch(prt);
+}
+
+/**
+ * Main loop of a worker process: takes tasks from the pipe until the parent
+ * closes it and searches each one, sending the lines found through the ring.
+ * Never returns.
+ *
+ * @param srch     the parent's state as it was at fork
+ * @param taskFd   read end of the task pipe
+ * @param ring     ring to send results through
+ * @param notifyFd write end of the notify pipe
+ */
+void runWorker(Search *srch, int taskFd, Ring *ring, int notifyFd)
+{
+    Printer prt = { &srch->query, NULL, srch->format, getpid(), getppid(), -1, ring, notifyFd, { NULL, 0, 0 } };
+    Source src;
+    int openFile = -1;
+    Task task;
+
+    while (read(taskFd, &task, sizeof(task)) == sizeof(task)){
+        const char *name = srch->files[task.file];
+        Stats stats = { 0, 0, 0 };
+        struct timespec begin, finish;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        prt.seq = task.seq;
+        prt.file = name;
+
+        //consecutive ranges of one file share the mapping
+        if (openFile != task.file){
+            if (openFile >= 0)
+                closeSource(&src);
+            openFile = -1;
+            if (openSource(&src, name) == 0)
+                openFile = task.file;
+            else {
+                fprintf(stderr, "Can't open file %s\n", name);
+                stats.failed = 1;
             }
         }
-        if (ch != '\n')
-            buffer[len++] = ch;
+
+        if (openFile >= 0 && src.mapped){
+            size_t end = (task.end < 0 || (size_t) task.end > src.size) ? src.size : (size_t) task.end;
+            size_t start = lineStart(src.data, src.size, (size_t) task.start < end ? (size_t) task.start : end);
+            scanLines(src.data, src.size, start, end, 0, &srch->query, printMatch, &prt);
+            //a line longer than the range can start past its end
+            stats.bytes = end > start ? end - start : 0;
+        }
+        else if (openFile >= 0){
+            if (scanSource(&src, &srch->query, printMatch, &prt) < 0){
+                fprintf(stderr, "Error reading file %s\n", name);
+                stats.failed = 1;
+            }
+            stats.bytes = (uint64_t) src.base + src.size;
+            closeSource(&src);
+            openFile = -1;
+        }
+
+        flushBatch(&prt);
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        stats.nsec = (uint64_t) (finish.tv_sec - begin.tv_sec) * 1000000000ULL + finish.tv_nsec - begin.tv_nsec;
+        sendMessage(&prt, MSG_DONE, &stats, sizeof(stats));
+    }
+
+    if (openFile >= 0)
+        closeSource(&src);
+    free(prt.batch.data);
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * Forks the worker process for a slot with fresh pipes and an empty ring.
+ *
+ * @param srch the parent's state
+ * @param w    the slot to start
+ */
+void startWorker(Search *srch, Worker *w)
+{
+    int taskFds[2];
+    int notifyFds[2];
+    if (pipe(taskFds) < 0 || pipe(notifyFds) < 0){
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    resetRing(w->ring);
+
+    w->pid = fork();
+    if (w->pid < 0){
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (w->pid == 0){
+        //drop the parent's ends of every other worker's pipes, or a worker would
+        //never see the end of its task pipe while a sibling holds it open
+        for (int i = 0; i < srch->numWorkers; i++){
+            Worker *other = &srch->workers[i];
+            if (other != w && other->pid > 0){
+                if (other->taskFd >= 0)
+                    close(other->taskFd);
+                close(other->notifyFd);
+            }
+        }
+        close(taskFds[1]);
+        close(notifyFds[0]);
+        fcntl(notifyFds[1], F_SETFL, O_NONBLOCK);
+        runWorker(srch, taskFds[0], w->ring, notifyFds[1]);
+    }
+
+    close(taskFds[0]);
+    close(notifyFds[1]);
+    fcntl(notifyFds[0], F_SETFL, O_NONBLOCK);
+    w->taskFd = taskFds[1];
+    w->notifyFd = notifyFds[0];
+    w->seq = -1;
+    w->jobs = 0;
+    w->bytes = 0;
+    w->nsec = 0;
+}
+
+/**
+ * Tells whether there are tasks left to hand out.
+ *
+ * @param srch the parent's state
+ * @return 1 if a task is waiting for a worker
+ */
+int tasksLeft(const Search *srch)
+{
+    return srch->numRequeued > 0 || srch->nextTask < srch->numTasks;
+}
+
+/**
+ * Hands the next task to an idle worker, or closes its task pipe (which makes it
+ * exit) when there are none left.
+ *
+ * @param srch the parent's state
+ * @param w    the idle worker
+ */
+void assignTask(Search *srch, Worker *w)
+{
+    if (tasksLeft(srch)){
+        Task *task = &srch->tasks[srch->numRequeued > 0 ? srch->requeued[srch->numRequeued - 1]
+                                                         : srch->nextTask];
+        //a failed write (EPIPE) means the worker died after its last task: the
+        //task stays queued for the worker that replaces it when this one is reaped
+        if (write(w->taskFd, task, sizeof(Task)) != sizeof(Task))
+            return;
+        if (srch->numRequeued > 0)
+            srch->numRequeued--;
         else
-            break;
+            srch->nextTask++;
+        w->seq = task->seq;
     }
+    else if (w->taskFd >= 0){
+        close(w->taskFd);
+        w->taskFd = -1;
+    }
+}
 
-    if (matches > 0){
-        buffer[len] = '\0';
-        return buffer;
+/**
+ * Writes output to the console, exiting if the console has gone away.
+ */
+void writeOutput(const char *data, size_t len)
+{
+    if (writeAll(STDOUT_FILENO, data, len) < 0)
+        exit(EXIT_FAILURE);
+}
+
+/**
+ * Writes the output of the finished tasks at the head of the output order, and
+ * whatever the current head task has sent so far.
+ *
+ * @param srch the parent's state
+ */
+void flushPending(Search *srch)
+{
+    while (srch->head < srch->numTasks){
+        Pending *p = &srch->pending[srch->head];
+        if (p->batch.len > 0){
+            writeOutput(p->batch.data, p->batch.len);
+            p->batch.len = 0;
+        }
+        if (!p->done)
+            break;
+        free(p->batch.data);
+        p->batch.data = NULL;
+        srch->head++;
     }
+}
+
+/**
+ * Reads every message waiting in a worker's ring.  Lines for the task being
+ * written go straight to the console; the rest are held until their turn.
+ *
+ * @param srch the parent's state
+ * @param w    the worker
+ */
+void drainWorker(Search *srch, Worker *w)
+{
+    static char body[MAX_MESSAGE];
+    Message msg;
+
+    while (ringUsed(w->ring) >= sizeof(msg)){
+        ringGet(w->ring, &msg, sizeof(msg));
+        ringGet(w->ring, body, msg.len);
 
-    free(buffer);
-    return NULL;
+        if (msg.kind == MSG_DATA){
+            flushPending(srch);
+            if (msg.seq == srch->head)
+                writeOutput(body, msg.len);
+            else
+                appendBatch(&srch->pending[msg.seq].batch, body, msg.len);
+        }
+        else {
+            Stats stats;
+            memcpy(&stats, body, sizeof(stats));
+            w->jobs++;
+            w->bytes += stats.bytes;
+            w->nsec += stats.nsec;
+            if (stats.failed)
+                srch->status = EXIT_FAILURE;
+            srch->pending[msg.seq].done = 1;
+            w->seq = -1;
+            assignTask(srch, w);
+        }
+    }
 }
 
 /**
- * Takes the word provided for the search and the input file name
- * then opens a FILE pointer to the provided input file. The text
- * within the input file is searched for any use of the provided
- * word and when the word is found the line of text containing it
- * is printed to the console.
+ * Reaps a worker whose notify pipe has closed.  A task the worker died without
+ * reading is still in its task pipe and is handed back to be searched by another
+ * worker; a worker that died in the middle of a task is reported.  If there is
+ * still work to do, the worker is replaced.
  *
- * @param word the string of text to find in the input file
- * @param input the filename of the input file to search
+ * @param srch the parent's state
+ * @param w    the worker
+ * @return 1 if a new worker was started in the slot, 0 if the slot is retired
+ */
+int reapWorker(Search *srch, Worker *w)
+{
+    int status;
+
+    drainWorker(srch, w);
+    close(w->notifyFd);
+    int unread = 0;
+    if (w->seq >= 0 && w->taskFd >= 0 && ioctl(w->taskFd, FIONREAD, &unread) == 0
+            && unread >= (int) sizeof(Task)){
+        srch->requeued[srch->numRequeued++] = w->seq;
+        w->seq = -1;
+    }
+    if (w->taskFd >= 0)
+        close(w->taskFd);
+    w->taskFd = -1;
+    waitpid(w->pid, &status, 0);
+
+    if (srch->verbose){
+        double secs = w->nsec / 1e9;
+        double mb = w->bytes / (1024.0 * 1024.0);
+        fprintf(stderr, "Worker %d (PID %d): %d jobs, %.1f MB in %.3f s (%.1f MB/s)\n",
+                (int) (w - srch->workers), (int) w->pid, w->jobs, mb, secs, secs > 0 ? mb / secs : 0.0);
+    }
+
+    if (w->seq >= 0){
+        const char *name = srch->files[srch->tasks[w->seq].file];
+        if (WIFSIGNALED(status))
+            fprintf(stderr, "Worker %d (PID %d) killed by signal %d while searching %s\n",
+                    (int) (w - srch->workers), (int) w->pid, WTERMSIG(status), name);
+        else
+            fprintf(stderr, "Worker %d (PID %d) exited while searching %s\n",
+                    (int) (w - srch->workers), (int) w->pid, name);
+        srch->pending[w->seq].done = 1;
+        srch->status = EXIT_FAILURE;
+        w->seq = -1;
+    }
+
+    if (tasksLeft(srch)){
+        startWorker(srch, w);
+        assignTask(srch, w);
+        return 1;
+    }
+    w->pid = 0;
+    return 0;
+}
+
+/**
+ * Splits the files into tasks: regular files larger than CHUNK_SIZE become one
+ * task per range, everything else is a single task.
  *
+ * @param srch     the parent's state
+ * @param numFiles number of files
  */
-void searchAndPrint(char const *word, char const *input)
+void makeTasks(Search *srch, int numFiles)
 {
-    FILE *fp = fopen(input, "r");
-    if (!fp){
-        fprintf(stderr, "Can't open file %s\n", input);
-        exit(1);
-    }
-
-    //character pointer to the line of text provided by the readLine function call
-    char *linetext;
-
-    //character pointer for holding the matched text to compare
-    char tempWord[MAX_BUFFER];
-
-    // to keep track of sscanf place in linetext
-    int val = 0;
-    int cursor = 0;
-
-    //loop through all available text in the input file line by line
-    while ((linetext = readLine(fp))){
-        while ((sscanf(linetext + cursor, "%s%n", tempWord, &val)) != EOF){
-            cursor += val;
-            //printf("word and tempword values %s %s\n", word, tempWord);
-            if (strcmp(word, tempWord) == 0){
-                printf("PID: %d ", getpid());
-                fprintf(stdout, "%s:  %s\n", word, linetext);
-                break;
+    int capacity = numFiles + 1;
+    srch->tasks = (Task *) malloc(capacity * sizeof(Task));
+    if (!srch->tasks)
+        exit(EXIT_FAILURE);
+    srch->numTasks = 0;
+
+    for (int i = 0; i < numFiles; i++){
+        struct stat st;
+        long long size = -1;
+        if (strcmp(srch->files[i], STDIN_NAME) != 0 && stat(srch->files[i], &st) == 0 && S_ISREG(st.st_mode))
+            size = (long long) st.st_size;
+
+        long long start = 0;
+        do {
+            if (srch->numTasks == capacity){
+                capacity *= 2;
+                srch->tasks = (Task *) realloc(srch->tasks, capacity * sizeof(Task));
+                if (!srch->tasks)
+                    exit(EXIT_FAILURE);
             }
-        }
-        cursor = 0;
+            Task *task = &srch->tasks[srch->numTasks];
+            task->seq = srch->numTasks++;
+            task->file = i;
+            task->start = start;
+            task->end = (size > CHUNK_SIZE && size - start > CHUNK_SIZE) ? start + CHUNK_SIZE : -1;
+            start = task->end;
+        } while (start > 0);
     }
+}
 
-    fclose(fp);
+/**
+ * Prints the usage message and exits.
+ *
+ * @param prog the program name
+ */
+void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] <word> <file>...\n", prog);
+    fprintf(stderr, "       %s [options] -f <pattern file> <file>...\n", prog);
+    fprintf(stderr, "options: -p processes, -o text|json|binary, -v\n");
+    exit(EXIT_FAILURE);
 }
 
 /**
@@ -121,27 +549,110 @@ void searchAndPrint(char const *word, char const *input)
  */
 int main(int argc, char *argv[])
 {
-    //array of process ID variables
-    pid_t pid[NUM_PROCS];
+    Search srch;
+    memset(&srch, 0, sizeof(srch));
+    srch.format = FORMAT_TEXT;
+    srch.status = EXIT_SUCCESS;
+    int numProcs = NUM_PROCS;
+    int opt;
 
-    //the word provided for search
-    char *word = argv[1];
+    //the word provided for search, or the patterns from the -f list file
+    while ((opt = getopt(argc, argv, "f:o:p:v")) != -1){
+        if (opt == 'f'){
+            srch.query.ac = loadAutomaton(optarg);
+            if (!srch.query.ac){
+                fprintf(stderr, "Can't read patterns from %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+        if (opt == 'o' && parseFormat(optarg, &srch.format) == 0)
+            continue;
+        if (opt == 'p' && atoi(optarg) > 0){
+            numProcs = atoi(optarg);
+            continue;
+        }
+        if (opt == 'v'){
+            srch.verbose = 1;
+            continue;
+        }
+        usage(argv[0]);
+    }
+    if (!srch.query.ac && optind < argc)
+        srch.query.word = argv[optind++];
+    if (!srch.query.ac && !srch.query.word)
+        usage(argv[0]);
+
+    srch.files = argv + optind;
+    makeTasks(&srch, argc - optind);
+    srch.pending = (Pending *) calloc(srch.numTasks + 1, sizeof(Pending));
+    srch.requeued = (int *) calloc(srch.numTasks + 1, sizeof(int));
+    srch.numWorkers = numProcs < srch.numTasks ? numProcs : srch.numTasks;
+    srch.workers = (Worker *) calloc(srch.numWorkers + 1, sizeof(Worker));
+    if (!srch.pending || !srch.requeued || !srch.workers)
+        exit(EXIT_FAILURE);
 
-    //loop through all provided text files and spawn processes
-    //parent process will always break and wait after loop for child
-    for (int i = 0; i < argc - 2; i++){
+    //a dead worker must not take the parent down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < srch.numWorkers; i++){
+        srch.workers[i].ring = createRing(RING_SIZE);
+        startWorker(&srch, &srch.workers[i]);
+        assignTask(&srch, &srch.workers[i]);
+    }
 
-        pid[i] = fork();
+    //wait for pokes from the workers until every one of them has exited
+    struct pollfd *fds = (struct pollfd *) malloc((srch.numWorkers + 1) * sizeof(struct pollfd));
+    int *slot = (int *) malloc((srch.numWorkers + 1) * sizeof(int));
+    if (!fds || !slot)
+        exit(EXIT_FAILURE);
+    int live = srch.numWorkers;
 
-        if (pid[i] == 0){
-            searchAndPrint(word, argv[i + 2]);
+    while (live > 0){
+        int count = 0;
+        for (int i = 0; i < srch.numWorkers; i++)
+            if (srch.workers[i].pid > 0){
+                fds[count].fd = srch.workers[i].notifyFd;
+                fds[count].events = POLLIN;
+                slot[count++] = i;
+            }
+
+        if (poll(fds, count, -1) < 0){
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            exit(EXIT_FAILURE);
         }
-        else {
-            break;
+
+        for (int i = 0; i < count; i++){
+            Worker *w = &srch.workers[slot[i]];
+            char pokes[256];
+            ssize_t n;
+            int gone = 0;
+
+            if (!fds[i].revents)
+                continue;
+            while ((n = read(w->notifyFd, pokes, sizeof(pokes))) > 0)
+                ;
+            if (n == 0)
+                gone = 1;
+
+            drainWorker(&srch, w);
+            if (gone && !reapWorker(&srch, w))
+                live--;
         }
+        flushPending(&srch);
     }
 
-    wait(NULL);
-
-    return EXIT_SUCCESS;
+    for (int i = 0; i < srch.numWorkers; i++)
+        freeRing(srch.workers[i].ring);
+    free(fds);
+    free(slot);
+    free(srch.workers);
+    free(srch.pending);
+    free(srch.requeued);
+    free(srch.tasks);
+    if (srch.query.ac)
+        freeAutomaton(srch.query.ac);
+    return srch.status;
 }
@@ -1,14 +1,30 @@
 /**
  * @author David Hines (dhhines)
- * @file find.c
+ * @file find2.c
  *
  * Program to search files provided on the command line for the provided word.
- * Each file provided will be searched using a separate process.  When the word
+ * The files are searched by a fixed pool of threads (one per core by default).
+ * Large files are split into byte ranges aligned on line boundaries so that a
+ * single big file is searched by all of the threads at once.  When the word
  * is found in the provided text files this program will print the word, the line
- * of text in which the word was found and the process ID of the process that
- * performed the search function.
+ * of text in which the word was found and the ID of the thread that performed
+ * the search function.  Each thread collects its lines in batches that a single
+ * writer thread puts out in file order; threads that get too far ahead of the
+ * writer wait once the buffered output reaches the -m limit.  With -o json or
+ * -o binary the matches are written as NDJSON or binary records (see output.h)
+ * instead of text.  With -f the words to find are read from a pattern list file
+ * (one per line) and every pattern found on a line is printed with it.  With
+ * --index the files are recorded in a persistent word index (only files that
+ * changed since the last run are read again) and the query is answered from the
+ * index; without files it searches every file already in the index.
  *
- * Compile commands: gcc -Wall -g -std=c99 find2.c -o find2 -lpthread
+ * Compilation: use provided Makefile
+ *              -usage: "make find2" or "make clean"
+ *
+ * Usage: ./find2 [options] <word> <file>... (use - to search standard input)
+ *        ./find2 [options] -f <pattern file> <file>...
+ *        ./find2 [options] --index <index file> <word | -f pattern file> [file]...
+ *        options: -j threads, -m output MB, -o text|json|binary
  */
 
 #include <stdlib.h>
@@ -16,118 +32,147 @@
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <pthread.h>
+#include "scan.h"
+#include "pool.h"
+#include "aho.h"
+#include "index.h"
+#include "output.h"
+
+//size of the byte ranges large files are split into
+#define CHUNK_SIZE (8 * 1024 * 1024)
+//default limit on buffered output in MB
+#define OUTPUT_MB 64
 
-//initial capacity of the line buffer
-#define INIT_CPCTY 10
-//standard multiplier for increasing size of line buffer
-#define STD_INCRMT 2
-//maximum word size
-#define MAX_BUFFER 200
-//number of possible threads
-#define NUM_THREADS 5
-
-struct Commands_Struct {
-    int numArgs;
-    char **arguments;
-    int lastProcessed;
+//data shared by every worker
+struct Search_Struct {
+    Query query;  //the word or patterns to search for
+    Source *sources;  //opened input files
+    Job *jobs;  //byte ranges to search, in output order
+    int numJobs;
+    Output *out;  //writer the matching lines are sent to
+    OutputFormat format;
 };
 
-typedef struct Commands_Struct Commands;
+typedef struct Search_Struct Search;
 
-//void function pointer threads will call as part of pthread_create
-void *searchAndPrint(void *param);
+//details written with each matching line
+struct Printer_Struct {
+    const Query *query;
+    const char *file;  //name of the file being searched
+    int tid;
+    int seq;  //job the lines belong to
+    OutputFormat format;
+    Output *out;
+    Batch batch;  //lines not yet handed to the writer
+};
+
+typedef struct Printer_Struct Printer;
 
 
 /**
- * This function reads a single line of input text from the file stream and then
- * returns the text as a string in a block of dynamically allocated memory.
+ * Formats a single matching line into the batch of the job that found it along
+ * with the words found on it (comma separated) and the identifier of the thread
+ * that found it.  Full batches are handed to the writer.
  *
- * @param *fp pointer to the input file stream to be parsed
- * @return pointer to the dynamic memory block holding the text of a single line
- *  from input file (or user command)
+ * @param text   pointer to the first character of the matching line
+ * @param line   offset and length of the line in the file
+ * @param ids    ids of the words found on the line
+ * @param numIds number of ids
+ * @param ctx    pointer to the Printer for the job that found the line
  */
-char *readLine(FILE *fp)
+void bufferMatch(const char *text, Slice line, const int *ids, int numIds, void *ctx)
 {
-    //create a resizeable array using malloc and realloc and a capacity integer
-    int capacity = INIT_CPCTY;
-    char *buffer = (char *) malloc (capacity * sizeof(char) + 1);
-    int len = 0;
-    char ch;
-    int matches = 0;
-
-    while ((matches = (fscanf(fp, "%c", &ch) == 1))){
-        if (len >= capacity){
-            capacity *= STD_INCRMT;
-            buffer = (char *) realloc (buffer, capacity * sizeof(char) + 1);
-            if (!buffer){
-                free(buffer);
-                exit(EXIT_FAILURE);
-            }
-        }
-        if (ch != '\n')
-            buffer[len++] = ch;
-        else
-            break;
-    }
+    Printer *prt = (Printer *)ctx;
+    Record rec = { prt->file, "TID", "tid", prt->tid, prt->query, ids, numIds, text, line };
+
+    formatRecord(&prt->batch, prt->format, &rec);
+    if (prt->batch.len >= BATCH_SIZE)
+        submitBatch(prt->out, prt->seq, &prt->batch);
+}
 
-    if (matches > 0){
-        buffer[len] = '\0';
-        return buffer;
+/**
+ * Searches the byte range of one job for the word.  Mapped files are scanned in
+ * place starting at the first line that begins inside the range; other sources
+ * are always a single job and are read through the scanner's buffer.
+ *
+ * @param job    the range of the file to search
+ * @param worker index of the thread running the job
+ * @param ctx    pointer to the shared Search data
+ */
+void searchJob(Job *job, int worker, void *ctx)
+{
+    Search *srch = (Search *)ctx;
+    Source *src = &srch->sources[job->file];
+    Printer prt = { &srch->query, src->name, worker, job->seq, srch->format, srch->out, { NULL, 0, 0 } };
+
+    if (src->mapped){
+        size_t start = lineStart(src->data, src->size, job->start);
+        scanLines(src->data, src->size, start, job->end, 0, &srch->query, bufferMatch, &prt);
     }
+    else if (scanSource(src, &srch->query, bufferMatch, &prt) < 0)
+        fprintf(stderr, "Error reading file %s\n", src->name);
 
-    free(buffer);
-    return NULL;
+    //hand the rest of the lines to the writer
+    finishSeq(srch->out, job->seq, &prt.batch);
 }
 
 /**
- * Takes the word provided for the search and the input file name
- * then opens a FILE pointer to the provided input file. The text
- * within the input file is searched for any use of the provided
- * word and when the word is found the line of text containing it
- * is printed to the console.
- *
- * @param word the string of text to find in the input file
- * @param input the filename of the input file to search
+ * Notes the file an index search is about to report lines from.
  *
+ * @param name name of the file
+ * @param ctx  pointer to the Printer
  */
-void *searchAndPrint(void *param)
+void indexFile(const char *name, void *ctx)
 {
-    Commands *t_cmds = (Commands *)param;
+    ((Printer *)ctx)->file = name;
+}
 
-    FILE *fp = fopen(t_cmds->arguments[t_cmds->lastProcessed], "r");
-    if (!fp){
-        fprintf(stderr, "Can't open file %s\n", t_cmds->arguments[t_cmds->lastProcessed]);
-        exit(1);
+/**
+ * Updates the index with the given files and answers the query from it.  The
+ * index already yields the lines in output order, so they all go to one job.
+ *
+ * @param path     name of the index file
+ * @param query    the word or patterns to search for
+ * @param files    files to search, or NULL for every file in the index
+ * @param numFiles number of files
+ * @param format   output format
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the index couldn't be used
+ */
+int searchWithIndex(const char *path, const Query *query, char *const *files, int numFiles,
+                    OutputFormat format)
+{
+    if (updateIndex(path, files, numFiles) < 0){
+        fprintf(stderr, "Can't write index %s\n", path);
+        return EXIT_FAILURE;
     }
 
-    //character pointer to the line of text provided by the readLine function call
-    char *linetext;
-
-    //character pointer for holding the matched text to compare
-    char tempWord[MAX_BUFFER];
-
-    // to keep track of sscanf place in linetext
-    int val = 0;
-    int cursor = 0;
-
-    //loop through all available text in the input file line by line
-    while ((linetext = readLine(fp))){
-        while ((sscanf(linetext + cursor, "%s%n", tempWord, &val)) != EOF){
-            cursor += val;
-            if (strcmp(t_cmds->arguments[0], tempWord) == 0){
-                //Note: couldn't figure out how to use the pthread_t value so used integer to
-                //identify threads from each other
-                printf("TID: %d  ", t_cmds->lastProcessed);
-                fprintf(stdout, "%s: %s\n", t_cmds->arguments[0], linetext);
-                break;
-            }
-        }
-        cursor = 0;
+    Output *out = createOutput(STDOUT_FILENO, 1, 1, (size_t) OUTPUT_MB << 20);
+    Printer prt = { query, NULL, 0, 0, format, out, { NULL, 0, 0 } };
+    long found = searchIndex(path, query, numFiles ? files : NULL, numFiles, indexFile, bufferMatch, &prt);
+
+    finishSeq(out, 0, &prt.batch);
+    int status = closeOutput(out) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (found < 0){
+        fprintf(stderr, "Can't read index %s\n", path);
+        status = EXIT_FAILURE;
     }
+    return status;
+}
 
-    fclose(fp);
-    pthread_exit(0);
+/**
+ * Prints the usage message and exits.
+ *
+ * @param prog the program name
+ */
+void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] <word> <file>...\n", prog);
+    fprintf(stderr, "       %s [options] -f <pattern file> <file>...\n", prog);
+    fprintf(stderr, "       %s [options] --index <index file> <word | -f pattern file> [file]...\n", prog);
+    fprintf(stderr, "options: -j threads, -m output MB, -o text|json|binary\n");
+    exit(EXIT_FAILURE);
 }
 
 /**
@@ -137,47 +182,114 @@ void *searchAndPrint(void *param)
  */
 int main(int argc, char *argv[])
 {
-    //array of process ID variables
-    pthread_t threads[NUM_THREADS];
-    //set of thread attributes for each worker thread
-    pthread_attr_t attr;
-    //set the thread attributes
-    pthread_attr_init(&attr);
-
-    //Initialize the command struct to hold arguments
-    Commands *cmds = (Commands *) malloc (sizeof(Commands));
-    //Set the number of args to be tracked in the struct using argc-1 value (ignores program name arg)
-    cmds->numArgs = argc - 1;
-    //Initialize the arguments pointer array to initial capacity
-    cmds->arguments = (char **) malloc(sizeof(char *) * cmds->numArgs);
-    //Set the last processed to 0 in struct as no commands processed yet
-    //this will be used to track which of the files has been processed by threads
-    //Note: set to 1 as we are not processing the word provided for search (which is index 0)
-    cmds->lastProcessed = 0;
-
-    //create the list of the command line args in dynamic memory
-    for(int i = 1; i < argc; ++i) {
-        cmds->arguments[i - 1] = malloc(strlen(argv[i]) + 1);
-        strcpy(cmds->arguments[i - 1], argv[i]);
+    int numThreads = numCores();
+    int status = EXIT_SUCCESS;
+    const char *patternFile = NULL;
+    const char *indexPath = NULL;
+    size_t outputMB = OUTPUT_MB;
+    static const struct option longOpts[] = {
+        { "index", required_argument, NULL, 'i' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+
+    Search srch;
+    srch.query.word = NULL;
+    srch.query.ac = NULL;
+    srch.format = FORMAT_TEXT;
+
+    while ((opt = getopt_long(argc, argv, "j:f:i:m:o:", longOpts, NULL)) != -1){
+        if (opt == 'j' && atoi(optarg) > 0)
+            numThreads = atoi(optarg);
+        else if (opt == 'f')
+            patternFile = optarg;
+        else if (opt == 'i')
+            indexPath = optarg;
+        else if (opt == 'm' && atoi(optarg) > 0)
+            outputMB = (size_t) atoi(optarg);
+        else if (opt != 'o' || parseFormat(optarg, &srch.format) < 0)
+            usage(argv[0]);
     }
 
-    //loop through all provided text files and spawn threads to search the list of files
-    for (int i = 0; i < argc - 2; i++){
+    //the search is either the next argument or the patterns in the list file
+    if (patternFile){
+        srch.query.ac = loadAutomaton(patternFile);
+        if (!srch.query.ac){
+            fprintf(stderr, "Can't read patterns from %s\n", patternFile);
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (optind < argc)
+        srch.query.word = argv[optind++];
+
+    //the index holds the file list, so naming files is optional with --index
+    if (indexPath && (srch.query.word || srch.query.ac)){
+        status = searchWithIndex(indexPath, &srch.query, argv + optind, argc - optind, srch.format);
+        if (srch.query.ac)
+            freeAutomaton(srch.query.ac);
+        return status;
+    }
+
+    if (optind >= argc)
+        usage(argv[0]);
+
+    int numFiles = argc - optind;
+    srch.sources = (Source *) calloc(numFiles, sizeof(Source));
+    if (!srch.sources)
+        exit(EXIT_FAILURE);
+
+    //open every file and count the byte ranges each one is split into
+    int numJobs = 0;
+    for (int i = 0; i < numFiles; i++){
+        Source *src = &srch.sources[i];
+        if (openSource(src, argv[optind + i]) < 0){
+            fprintf(stderr, "Can't open file %s\n", argv[optind + i]);
+            status = EXIT_FAILURE;
+            src->name = argv[optind + i];
+            src->data = NULL;
+            src->mapped = 1;
+            src->size = 0;
+        }
+        numJobs += (src->mapped && src->size > CHUNK_SIZE) ? (src->size + CHUNK_SIZE - 1) / CHUNK_SIZE : 1;
+    }
 
-        //printf("ThreadID: %d  ", i);
-        pthread_create(&threads[i], &attr, searchAndPrint, cmds);
-        cmds->lastProcessed++;
+    srch.numJobs = numJobs;
+    srch.jobs = (Job *) malloc(numJobs * sizeof(Job));
+    if (!srch.jobs)
+        exit(EXIT_FAILURE);
+    srch.out = createOutput(STDOUT_FILENO, numJobs, numThreads, outputMB << 20);
 
-        //thread join when thread completes task
-        pthread_join(threads[i], NULL);
+    //deal the jobs out round robin so every thread starts near the front of the
+    //output order and the writer can print while the rest are searched
+    Pool *pool = createPool(numThreads, searchJob, &srch);
+    int seq = 0;
+    for (int i = 0; i < numFiles; i++){
+        Source *src = &srch.sources[i];
+        size_t start = 0;
+        do {
+            Job *job = &srch.jobs[seq];
+            job->seq = seq;
+            job->file = i;
+            job->start = start;
+            job->end = (src->mapped && src->size - start > CHUNK_SIZE) ? start + CHUNK_SIZE : src->size;
+            submitJob(pool, seq % numThreads, job);
+            start = job->end;
+            seq++;
+        } while (src->mapped && start < src->size);
     }
 
-    //free the memory for each argument string
-    for (int i = 0; i < cmds->numArgs; i++)
-        free(cmds->arguments[i]);
+    startPool(pool);
+    joinPool(pool);
+    if (closeOutput(srch.out) < 0)
+        status = EXIT_FAILURE;
 
-    //free memory for the Command struct
-    free(cmds);
+    //release the files and shared data
+    for (int i = 0; i < numFiles; i++)
+        closeSource(&srch.sources[i]);
+    free(srch.sources);
+    free(srch.jobs);
+    if (srch.query.ac)
+        freeAutomaton(srch.query.ac);
 
-    return EXIT_SUCCESS;
+    return status;
 }
@@ -0,0 +1,826 @@
+/**
+ * @author David Hines (dhhines)
+ * @file index.c
+ *
+ * Implementation of the persistent inverted index (see index.h).
+ *
+ * File layout (native byte order, every section 8 byte aligned):
+ *   IndexHeader
+ *   FileEntry[numFiles]     size and mtime of each indexed file
+ *   TermEntry[numTerms]     sorted by term text, for binary search
+ *   strings                 NUL terminated file names and term texts
+ *   postings                per term: (file delta, line offset delta) varint pairs
+ *
+ * Within a term the postings are ordered by file and line.  A file delta of zero
+ * means "same file" and the offset is relative to the previous line; a non-zero
+ * file delta starts a new file and the offset that follows is absolute.
+ */
+
+#include "index.h"
+#include "aho.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//identifies an index file (and its format version)
+#define INDEX_MAGIC "FINDIDX1"
+//initial capacity of the growable arrays
+#define INIT_CPCTY 16
+//standard multiplier for increasing size of the arrays
+#define STD_INCRMT 2
+
+//fixed size header at the start of the index file
+typedef struct IndexHeader_Struct {
+    char magic[8];
+    uint32_t numFiles;
+    uint32_t numTerms;
+    uint64_t stringsOffset;  //start of the strings section
+    uint64_t postingsOffset;  //start of the postings section
+    uint64_t totalSize;  //size of the whole file
+} IndexHeader;
+
+//an indexed file as stored in the index
+typedef struct FileEntry_Struct {
+    uint64_t nameOffset;  //offset of the file name in the strings section
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+} FileEntry;
+
+//a term as stored in the index
+typedef struct TermEntry_Struct {
+    uint64_t termOffset;  //offset of the term text in the strings section
+    uint64_t postingsOffset;  //offset of the postings in the postings section
+    uint64_t postingsLen;  //bytes of postings
+    uint32_t termLen;
+    uint32_t unused;
+} TermEntry;
+
+//an index file mapped for reading
+typedef struct MappedIndex_Struct {
+    char *data;
+    size_t size;
+    const IndexHeader *hdr;
+    const FileEntry *files;
+    const TermEntry *terms;
+    const char *strings;
+    const uint8_t *postings;
+} MappedIndex;
+
+//postings of one term while an index is being built
+typedef struct Term_Struct {
+    uint64_t textOffset;  //offset of the term text in the builder's text arena
+    uint32_t len;
+    uint32_t hash;
+    uint8_t *buf;  //encoded postings
+    size_t used;
+    size_t capacity;
+    int64_t lastFile;  //file of the last posting (-1 before the first)
+    uint64_t lastLine;  //line offset of the last posting
+} Term;
+
+//in-memory index under construction
+typedef struct Builder_Struct {
+    char *text;  //arena holding the text of every term
+    size_t textLen;
+    size_t textCap;
+    Term *terms;
+    int numTerms;
+    int termsCap;
+    int32_t *table;  //open addressed hash table of term numbers (-1 is empty)
+    size_t tableCap;
+} Builder;
+
+//a file of the index being built
+typedef struct FileInfo_Struct {
+    char *name;  //canonical path of the file
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    int oldId;  //id of the file in the old index, or -1
+    int reused;  //1 when the old postings are still valid
+} FileInfo;
+
+//a term and its number, sorted before the term table is written
+typedef struct SortedTerm_Struct {
+    const char *text;
+    uint32_t len;
+    int id;
+} SortedTerm;
+
+//a candidate line found in the postings
+typedef struct Candidate_Struct {
+    int rank;  //position of the file in the output order
+    uint64_t line;  //offset of the line in the file
+} Candidate;
+
+/**
+ * Maps an index file and checks that its sections are in bounds.
+ *
+ * @param idx  the index to fill in
+ * @param path name of the index file
+ * @return 0 on success, -1 if the file is missing or not a valid index
+ */
+static int openIndex(MappedIndex *idx, const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    memset(idx, 0, sizeof(MappedIndex));
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(IndexHeader)){
+        close(fd);
+        return -1;
+    }
+
+    idx->size = (size_t) st.st_size;
+    idx->data = mmap(NULL, idx->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (idx->data == MAP_FAILED){
+        idx->data = NULL;
+        return -1;
+    }
+
+    const IndexHeader *hdr = (const IndexHeader *) idx->data;
+    uint64_t tables = sizeof(IndexHeader) + (uint64_t) hdr->numFiles * sizeof(FileEntry)
+                      + (uint64_t) hdr->numTerms * sizeof(TermEntry);
+    if (memcmp(hdr->magic, INDEX_MAGIC, 8) != 0 || hdr->totalSize != idx->size
+            || hdr->stringsOffset < tables || hdr->postingsOffset < hdr->stringsOffset
+            || hdr->postingsOffset > idx->size){
+        munmap(idx->data, idx->size);
+        idx->data = NULL;
+        return -1;
+    }
+
+    idx->hdr = hdr;
+    idx->files = (const FileEntry *) (idx->data + sizeof(IndexHeader));
+    idx->terms = (const TermEntry *) (idx->files + hdr->numFiles);
+    idx->strings = idx->data + hdr->stringsOffset;
+    idx->postings = (const uint8_t *) idx->data + hdr->postingsOffset;
+
+    //every name, term and postings list has to lie within its section, so a
+    //truncated or corrupt index is turned away here rather than read past its end
+    uint64_t stringsLen = hdr->postingsOffset - hdr->stringsOffset;
+    uint64_t postingsLen = idx->size - hdr->postingsOffset;
+    int valid = 1;
+    for (uint32_t i = 0; valid && i < hdr->numFiles; i++){
+        uint64_t name = idx->files[i].nameOffset;
+        valid = name < stringsLen && memchr(idx->strings + name, '\0', stringsLen - name);
+    }
+    for (uint32_t i = 0; valid && i < hdr->numTerms; i++){
+        const TermEntry *te = &idx->terms[i];
+        valid = te->termOffset <= stringsLen && te->termLen <= stringsLen - te->termOffset
+                && te->postingsOffset <= postingsLen
+                && te->postingsLen <= postingsLen - te->postingsOffset;
+    }
+    if (!valid){
+        munmap(idx->data, idx->size);
+        memset(idx, 0, sizeof(MappedIndex));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Unmaps an index file.
+ *
+ * @param idx the index to close
+ */
+static void closeIndex(MappedIndex *idx)
+{
+    if (idx->data)
+        munmap(idx->data, idx->size);
+    idx->data = NULL;
+}
+
+/**
+ * Binary searches the term table of a mapped index.
+ *
+ * @param idx  the index
+ * @param term text of the term
+ * @param len  length of the term
+ * @return the term's entry, or NULL if the term isn't in the index
+ */
+static const TermEntry *findTerm(const MappedIndex *idx, const char *term, size_t len)
+{
+    size_t lo = 0;
+    size_t hi = idx->hdr->numTerms;
+
+    while (lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        const TermEntry *te = &idx->terms[mid];
+        size_t common = te->termLen < len ? te->termLen : len;
+        int cmp = memcmp(idx->strings + te->termOffset, term, common);
+
+        if (cmp == 0)
+            cmp = te->termLen < len ? -1 : te->termLen > len ? 1 : 0;
+        if (cmp == 0)
+            return te;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+/**
+ * Reads one varint and advances the cursor.
+ *
+ * @param pos cursor into the postings
+ * @param end end of the postings
+ * @return the decoded value
+ */
+static uint64_t getVarint(const uint8_t **pos, const uint8_t *end)
+{
+    uint64_t value = 0;
+    int shift = 0;
+
+    while (*pos < end){
+        uint8_t byte = *(*pos)++;
+        if (shift < 64)
+            value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            break;
+        shift += 7;
+    }
+    return value;
+}
+
+/**
+ * Appends one varint to the postings of a term.
+ *
+ * @param term  the term
+ * @param value the value to encode
+ */
+static void putVarint(Term *term, uint64_t value)
+{
+    if (term->used + 10 > term->capacity){
+        size_t capacity = term->capacity ? term->capacity * STD_INCRMT : INIT_CPCTY;
+        term->buf = (uint8_t *) realloc(term->buf, capacity);
+        if (!term->buf)
+            exit(EXIT_FAILURE);
+        term->capacity = capacity;
+    }
+
+    while (value >= 0x80){
+        term->buf[term->used++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    term->buf[term->used++] = (uint8_t) value;
+}
+
+/**
+ * FNV-1a hash of a term.
+ */
+static uint32_t hashTerm(const char *text, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t) text[i]) * 16777619u;
+    return hash;
+}
+
+/**
+ * Rebuilds the builder's hash table at twice the size.
+ *
+ * @param b the builder
+ */
+static void growTable(Builder *b)
+{
+    b->tableCap = b->tableCap ? b->tableCap * STD_INCRMT : 1024;
+    free(b->table);
+    b->table = (int32_t *) malloc(b->tableCap * sizeof(int32_t));
+    if (!b->table)
+        exit(EXIT_FAILURE);
+    memset(b->table, 0xff, b->tableCap * sizeof(int32_t));
+
+    for (int i = 0; i < b->numTerms; i++){
+        size_t slot = b->terms[i].hash & (b->tableCap - 1);
+        while (b->table[slot] >= 0)
+            slot = (slot + 1) & (b->tableCap - 1);
+        b->table[slot] = i;
+    }
+}
+
+/**
+ * Finds a term in the builder, adding it if it is new.
+ *
+ * @param b    the builder
+ * @param text text of the term (not NUL terminated)
+ * @param len  length of the term
+ * @return the term number
+ */
+static int internTerm(Builder *b, const char *text, size_t len)
+{
+    if ((size_t) (b->numTerms + 1) * 2 > b->tableCap)
+        growTable(b);
+
+    uint32_t hash = hashTerm(text, len);
+    size_t slot = hash & (b->tableCap - 1);
+
+    while (b->table[slot] >= 0){
+        Term *t = &b->terms[b->table[slot]];
+        if (t->hash == hash && t->len == len && memcmp(b->text + t->textOffset, text, len) == 0)
+            return b->table[slot];
+        slot = (slot + 1) & (b->tableCap - 1);
+    }
+
+    //copy the text into the arena (NUL terminated for writing)
+    while (b->textLen + len + 1 > b->textCap){
+        b->textCap = b->textCap ? b->textCap * STD_INCRMT : 64 * 1024;
+        b->text = (char *) realloc(b->text, b->textCap);
+        if (!b->text)
+            exit(EXIT_FAILURE);
+    }
+    if (b->numTerms == b->termsCap){
+        b->termsCap = b->termsCap ? b->termsCap * STD_INCRMT : 1024;
+        b->terms = (Term *) realloc(b->terms, b->termsCap * sizeof(Term));
+        if (!b->terms)
+            exit(EXIT_FAILURE);
+    }
+
+    Term *t = &b->terms[b->numTerms];
+    memset(t, 0, sizeof(Term));
+    t->textOffset = b->textLen;
+    t->len = (uint32_t) len;
+    t->hash = hash;
+    t->lastFile = -1;
+    memcpy(b->text + b->textLen, text, len);
+    b->text[b->textLen + len] = '\0';
+    b->textLen += len + 1;
+
+    b->table[slot] = b->numTerms;
+    return b->numTerms++;
+}
+
+/**
+ * Records that a term appears on a line.  Postings must arrive in file and line
+ * order; repeats of a term on the same line are dropped.
+ *
+ * @param b    the builder
+ * @param id   the term number
+ * @param file the file number in the new index
+ * @param line offset of the line in the file
+ */
+static void addPosting(Builder *b, int id, uint32_t file, uint64_t line)
+{
+    Term *t = &b->terms[id];
+
+    if (t->lastFile == (int64_t) file){
+        if (t->lastLine == line)
+            return;
+        putVarint(t, 0);
+        putVarint(t, line - t->lastLine);
+    }
+    else {
+        putVarint(t, (uint64_t) ((int64_t) file - t->lastFile));
+        putVarint(t, line);
+    }
+    t->lastFile = file;
+    t->lastLine = line;
+}
+
+/**
+ * Adds every word of a file to the builder, splitting it the same way as the
+ * search does.
+ *
+ * @param b    the builder
+ * @param file the file number in the new index
+ * @param data the text of the file
+ * @param size number of bytes of text
+ */
+static void indexText(Builder *b, uint32_t file, const char *data, size_t size)
+{
+    size_t pos = 0;
+    size_t line = 0;
+
+    while (pos < size){
+        char ch = data[pos];
+        if (ch == '\n'){
+            line = ++pos;
+            continue;
+        }
+        if (isDelim(ch)){
+            pos++;
+            continue;
+        }
+
+        size_t tok = pos;
+        while (pos < size && !isDelim(data[pos]))
+            pos++;
+        addPosting(b, internTerm(b, data + tok, pos - tok), file, line);
+    }
+}
+
+/**
+ * Releases everything held by a builder.
+ *
+ * @param b the builder
+ */
+static void freeBuilder(Builder *b)
+{
+    for (int i = 0; i < b->numTerms; i++)
+        free(b->terms[i].buf);
+    free(b->terms);
+    free(b->text);
+    free(b->table);
+}
+
+/**
+ * Orders terms by their bytes, shorter first on a common prefix (the order the
+ * binary search in findTerm expects).
+ */
+static int compareTerms(const void *a, const void *b)
+{
+    const SortedTerm *x = (const SortedTerm *) a;
+    const SortedTerm *y = (const SortedTerm *) b;
+    size_t common = x->len < y->len ? x->len : y->len;
+    int cmp = memcmp(x->text, y->text, common);
+
+    if (cmp != 0)
+        return cmp;
+    return x->len < y->len ? -1 : x->len > y->len ? 1 : 0;
+}
+
+/**
+ * Writes 0 bytes up to the next multiple of 8.
+ *
+ * @param fp     the file being written
+ * @param offset current offset in the file; updated
+ */
+static void padTo8(FILE *fp, uint64_t *offset)
+{
+    static const char zeros[8];
+    size_t pad = (size_t) ((8 - (*offset & 7)) & 7);
+
+    fwrite(zeros, 1, pad, fp);
+    *offset += pad;
+}
+
+/**
+ * Writes the built index to a temporary file and renames it over the index.
+ *
+ * @param path     name of the index file
+ * @param b        the builder holding the postings
+ * @param files    the files of the index, in file number order
+ * @param numFiles number of files
+ * @return 0 on success, -1 if the file couldn't be written
+ */
+static int writeIndex(const char *path, Builder *b, const FileInfo *files, int numFiles)
+{
+    //terms that lost all their postings are left out
+    SortedTerm *sorted = (SortedTerm *) malloc((b->numTerms + 1) * sizeof(SortedTerm));
+    if (!sorted)
+        exit(EXIT_FAILURE);
+    int numTerms = 0;
+    for (int i = 0; i < b->numTerms; i++){
+        if (b->terms[i].used == 0)
+            continue;
+        sorted[numTerms].text = b->text + b->terms[i].textOffset;
+        sorted[numTerms].len = b->terms[i].len;
+        sorted[numTerms].id = i;
+        numTerms++;
+    }
+    qsort(sorted, numTerms, sizeof(SortedTerm), compareTerms);
+
+    //lay out the sections
+    IndexHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, INDEX_MAGIC, 8);
+    hdr.numFiles = (uint32_t) numFiles;
+    hdr.numTerms = (uint32_t) numTerms;
+    hdr.stringsOffset = sizeof(IndexHeader) + (uint64_t) numFiles * sizeof(FileEntry)
+                        + (uint64_t) numTerms * sizeof(TermEntry);
+
+    uint64_t stringsLen = 0;
+    for (int i = 0; i < numFiles; i++)
+        stringsLen += strlen(files[i].name) + 1;
+    for (int i = 0; i < numTerms; i++)
+        stringsLen += sorted[i].len + 1;
+    hdr.postingsOffset = (hdr.stringsOffset + stringsLen + 7) & ~(uint64_t) 7;
+
+    uint64_t postingsLen = 0;
+    for (int i = 0; i < numTerms; i++)
+        postingsLen += b->terms[sorted[i].id].used;
+    hdr.totalSize = hdr.postingsOffset + postingsLen;
+
+    char *tmp = (char *) malloc(strlen(path) + 5);
+    if (!tmp)
+        exit(EXIT_FAILURE);
+    sprintf(tmp, "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp){
+        free(tmp);
+        free(sorted);
+        return -1;
+    }
+
+    uint64_t offset = 0;
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    offset += sizeof(hdr);
+
+    //file table, names are the first strings
+    uint64_t stringPos = 0;
+    for (int i = 0; i < numFiles; i++){
+        FileEntry fe = { stringPos, files[i].size, files[i].mtimeSec, files[i].mtimeNsec };
+        fwrite(&fe, sizeof(fe), 1, fp);
+        stringPos += strlen(files[i].name) + 1;
+    }
+
+    //term table, texts follow the names
+    uint64_t postingPos = 0;
+    for (int i = 0; i < numTerms; i++){
+        const Term *t = &b->terms[sorted[i].id];
+        TermEntry te = { stringPos, postingPos, t->used, t->len, 0 };
+        fwrite(&te, sizeof(te), 1, fp);
+        stringPos += t->len + 1;
+        postingPos += t->used;
+    }
+    offset = hdr.stringsOffset;
+
+    for (int i = 0; i < numFiles; i++)
+        fwrite(files[i].name, 1, strlen(files[i].name) + 1, fp);
+    for (int i = 0; i < numTerms; i++)
+        fwrite(sorted[i].text, 1, sorted[i].len + 1, fp);
+    offset += stringsLen;
+    padTo8(fp, &offset);
+
+    for (int i = 0; i < numTerms; i++){
+        const Term *t = &b->terms[sorted[i].id];
+        fwrite(t->buf, 1, t->used, fp);
+    }
+
+    int status = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0)
+        status = -1;
+    if (status == 0 && rename(tmp, path) != 0)
+        status = -1;
+    if (status != 0)
+        unlink(tmp);
+
+    free(tmp);
+    free(sorted);
+    return status;
+}
+
+/**
+ * Fills in the size and modification time of a file.
+ *
+ * @param info the file to update
+ * @return 0 on success, -1 if the file is gone or isn't a regular file
+ */
+static int statFile(FileInfo *info)
+{
+    struct stat st;
+
+    if (stat(info->name, &st) < 0 || !S_ISREG(st.st_mode))
+        return -1;
+    info->size = (uint64_t) st.st_size;
+    info->mtimeSec = (int64_t) st.st_mtim.tv_sec;
+    info->mtimeNsec = (int64_t) st.st_mtim.tv_nsec;
+    return 0;
+}
+
+int updateIndex(const char *path, char *const *files, int numFiles)
+{
+    MappedIndex old;
+    int haveOld = openIndex(&old, path) == 0;
+    int oldFiles = haveOld ? (int) old.hdr->numFiles : 0;
+    int changed = !haveOld;
+
+    FileInfo *list = (FileInfo *) calloc(oldFiles + numFiles + 1, sizeof(FileInfo));
+    if (!list)
+        exit(EXIT_FAILURE);
+    int count = 0;
+
+    //files already in the index that still exist
+    for (int i = 0; i < oldFiles; i++){
+        const FileEntry *fe = &old.files[i];
+        FileInfo *info = &list[count];
+        info->name = strdup(old.strings + fe->nameOffset);
+        info->oldId = i;
+        if (statFile(info) < 0){
+            free(info->name);
+            changed = 1;
+            continue;
+        }
+        info->reused = info->size == fe->size && info->mtimeSec == fe->mtimeSec
+                       && info->mtimeNsec == fe->mtimeNsec;
+        changed |= !info->reused;
+        count++;
+    }
+
+    //files named on the command line that aren't in the index yet
+    for (int i = 0; i < numFiles; i++){
+        char canon[PATH_MAX];
+        if (strcmp(files[i], STDIN_NAME) == 0 || !realpath(files[i], canon)){
+            fprintf(stderr, "Can't index file %s\n", files[i]);
+            continue;
+        }
+
+        int known = 0;
+        for (int j = 0; j < count && !known; j++)
+            known = strcmp(list[j].name, canon) == 0;
+        if (known)
+            continue;
+
+        FileInfo *info = &list[count];
+        info->name = strdup(canon);
+        info->oldId = -1;
+        if (statFile(info) < 0){
+            fprintf(stderr, "Can't index file %s\n", files[i]);
+            free(info->name);
+            continue;
+        }
+        changed = 1;
+        count++;
+    }
+
+    int status = 0;
+    if (changed){
+        //number the reused files first (keeping their old order) so their
+        //postings can be copied over in order before the other files are read
+        FileInfo *ordered = (FileInfo *) malloc((count + 1) * sizeof(FileInfo));
+        int *newId = (int *) malloc((oldFiles + 1) * sizeof(int));
+        if (!ordered || !newId)
+            exit(EXIT_FAILURE);
+        int numReused = 0;
+        for (int i = 0; i < oldFiles; i++)
+            newId[i] = -1;
+        for (int i = 0; i < count; i++)
+            if (list[i].reused){
+                newId[list[i].oldId] = numReused;
+                ordered[numReused++] = list[i];
+            }
+        int next = numReused;
+        for (int i = 0; i < count; i++)
+            if (!list[i].reused)
+                ordered[next++] = list[i];
+
+        Builder b;
+        memset(&b, 0, sizeof(b));
+
+        //copy the postings of the unchanged files out of the old index
+        for (uint32_t t = 0; haveOld && numReused > 0 && t < old.hdr->numTerms; t++){
+            const TermEntry *te = &old.terms[t];
+            const uint8_t *pos = old.postings + te->postingsOffset;
+            const uint8_t *end = pos + te->postingsLen;
+            int id = internTerm(&b, old.strings + te->termOffset, te->termLen);
+            uint64_t file = (uint64_t) -1;
+            uint64_t line = 0;
+
+            while (pos < end){
+                uint64_t fileDelta = getVarint(&pos, end);
+                uint64_t lineDelta = getVarint(&pos, end);
+                file += fileDelta;
+                line = fileDelta ? lineDelta : line + lineDelta;
+                if (file < (uint64_t) oldFiles && newId[file] >= 0)
+                    addPosting(&b, id, (uint32_t) newId[file], line);
+            }
+        }
+
+        //read the new and changed files
+        for (int i = numReused; i < count; i++){
+            Source src;
+            if (openSource(&src, ordered[i].name) < 0){
+                fprintf(stderr, "Can't open file %s\n", ordered[i].name);
+                //no stat matches this time, so the next update reads the file again
+                ordered[i].mtimeNsec = -1;
+                continue;
+            }
+            indexText(&b, (uint32_t) i, src.data, src.size);
+            closeSource(&src);
+        }
+
+        status = writeIndex(path, &b, ordered, count);
+        freeBuilder(&b);
+        free(ordered);
+        free(newId);
+    }
+
+    for (int i = 0; i < count; i++)
+        free(list[i].name);
+    free(list);
+    closeIndex(&old);
+    return status;
+}
+
+/**
+ * Orders candidates by output rank, then by line.
+ */
+static int compareCandidates(const void *a, const void *b)
+{
+    const Candidate *x = (const Candidate *) a;
+    const Candidate *y = (const Candidate *) b;
+
+    if (x->rank != y->rank)
+        return x->rank < y->rank ? -1 : 1;
+    return x->line < y->line ? -1 : x->line > y->line ? 1 : 0;
+}
+
+long searchIndex(const char *path, const Query *query, char *const *files, int numFiles,
+                 FileFunc onFile, MatchFunc onMatch, void *ctx)
+{
+    MappedIndex idx;
+    if (openIndex(&idx, path) < 0)
+        return -1;
+
+    //rank each indexed file by where it is printed (-1 when it isn't wanted)
+    int indexed = (int) idx.hdr->numFiles;
+    int *rank = (int *) malloc((indexed + 1) * sizeof(int));
+    if (!rank)
+        exit(EXIT_FAILURE);
+    for (int i = 0; i < indexed; i++)
+        rank[i] = files ? -1 : i;
+
+    for (int i = 0; files && i < numFiles; i++){
+        char canon[PATH_MAX];
+        if (!realpath(files[i], canon))
+            continue;
+        for (int j = 0; j < indexed; j++)
+            if (rank[j] < 0 && strcmp(idx.strings + idx.files[j].nameOffset, canon) == 0){
+                rank[j] = i;
+                break;
+            }
+    }
+
+    //gather the lines of every query term
+    int numTerms = query->ac ? numPatterns(query->ac) : 1;
+    size_t count = 0;
+    size_t capacity = INIT_CPCTY;
+    Candidate *cands = (Candidate *) malloc(capacity * sizeof(Candidate));
+    if (!cands)
+        exit(EXIT_FAILURE);
+
+    for (int t = 0; t < numTerms; t++){
+        const char *term = queryWord(query, t);
+        const TermEntry *te = findTerm(&idx, term, strlen(term));
+        if (!te)
+            continue;
+
+        const uint8_t *pos = idx.postings + te->postingsOffset;
+        const uint8_t *end = pos + te->postingsLen;
+        uint64_t file = (uint64_t) -1;
+        uint64_t line = 0;
+
+        while (pos < end){
+            uint64_t fileDelta = getVarint(&pos, end);
+            uint64_t lineDelta = getVarint(&pos, end);
+            file += fileDelta;
+            line = fileDelta ? lineDelta : line + lineDelta;
+            if (file >= (uint64_t) indexed || rank[file] < 0)
+                continue;
+
+            if (count == capacity){
+                capacity *= STD_INCRMT;
+                cands = (Candidate *) realloc(cands, capacity * sizeof(Candidate));
+                if (!cands)
+                    exit(EXIT_FAILURE);
+            }
+            cands[count].rank = rank[file];
+            cands[count].line = line;
+            count++;
+        }
+    }
+    qsort(cands, count, sizeof(Candidate), compareCandidates);
+
+    //rescan each distinct candidate line so the output (and the list of words on
+    //it) is exactly what a full search would print
+    long found = 0;
+    size_t i = 0;
+    while (i < count){
+        int r = cands[i].rank;
+        const char *name = NULL;
+        for (int j = 0; j < indexed && !name; j++)
+            if (rank[j] == r)
+                name = idx.strings + idx.files[j].nameOffset;
+
+        Source src;
+        int ok = openSource(&src, name) == 0 && src.mapped;
+        uint64_t last = (uint64_t) -1;
+        if (ok)
+            onFile(files ? files[r] : name, ctx);
+
+        for (; i < count && cands[i].rank == r; i++){
+            if (!ok || cands[i].line == last || cands[i].line >= src.size)
+                continue;
+            last = cands[i].line;
+            found += scanLines(src.data, src.size, last, last + 1, 0, query, onMatch, ctx);
+        }
+        if (ok)
+            closeSource(&src);
+    }
+
+    free(cands);
+    free(rank);
+    closeIndex(&idx);
+    return found;
+}
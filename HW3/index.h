@@ -0,0 +1,61 @@
+/**
+ * @author David Hines (dhhines)
+ * @file index.h
+ *
+ * Persistent inverted index for repeated find2 queries over the same files.  The
+ * index maps every word (using the same whitespace tokenization as the search)
+ * to the lines it appears on, stored as (file, line offset) postings that are
+ * delta encoded and packed as varints.  The index file is laid out so it can be
+ * mapped and searched in place: a sorted term table is binary searched and only
+ * the postings of the query terms are touched.
+ *
+ * The index remembers the size and modification time of every file, so an update
+ * only re-reads the files that changed; the postings of unchanged files are copied
+ * over from the old index without looking at the files again.
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "scan.h"
+
+/**
+ * Function called by searchIndex before the matching lines of each file.
+ *
+ * @param name name of the file (as given to searchIndex, or as stored in the index)
+ * @param ctx  caller supplied context pointer
+ */
+typedef void (*FileFunc)(const char *name, void *ctx);
+
+/**
+ * Brings the index up to date.  The indexed set is every file already in the
+ * index that still exists plus the given files.  The index is rewritten (through
+ * a temporary file and a rename) only if some file was added, changed or removed.
+ *
+ * @param path     name of the index file (created if it doesn't exist, or rebuilt
+ *  if it isn't a valid index)
+ * @param files    names of files to add to the index
+ * @param numFiles number of names
+ * @return 0 on success, -1 if the index couldn't be written
+ */
+int updateIndex(const char *path, char *const *files, int numFiles);
+
+/**
+ * Looks the query up in the index and calls onMatch for every matching line.  The
+ * candidate lines are checked against the file with the normal scanner, so the
+ * output is the same as a full search.
+ *
+ * @param path     name of the index file
+ * @param query    the word or patterns to search for
+ * @param files    files to report matches for in this order, or NULL for every
+ *  file in the index
+ * @param numFiles number of names in files
+ * @param onFile   function called before the lines of each file that has matches
+ * @param onMatch  function called for each matching line
+ * @param ctx      context pointer passed through to onMatch
+ * @return number of matching lines, or -1 if the index can't be read
+ */
+long searchIndex(const char *path, const Query *query, char *const *files, int numFiles,
+                 FileFunc onFile, MatchFunc onMatch, void *ctx);
+
+#endif
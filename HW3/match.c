@@ -0,0 +1,232 @@
+/**
+ * @author David Hines (dhhines)
+ * @file match.c
+ *
+ * Implementation of the whole-word match kernels (see match.h).  Each vector kernel
+ * builds three bit masks per block: bytes equal to the first letter of the word,
+ * bytes preceded by a delimiter, and bytes followed (wlen bytes later) by a
+ * delimiter.  Only positions set in all three masks are compared with memcmp, so
+ * almost every byte of the text is handled without a branch.
+ */
+
+#include "match.h"
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+//kernel used by findWord and its name
+static FindFunc current;
+static const char *currentName;
+
+/**
+ * Returns true for the word delimiters: ' ' and '\t' through '\r'.
+ *
+ * @param ch the character to test
+ * @return 1 if ch is a delimiter, 0 otherwise
+ */
+static inline int delim(char ch)
+{
+    return ch == ' ' || (unsigned char) (ch - '\t') < 5;
+}
+
+/**
+ * Scalar search starting at offset pos of the block.  Uses memchr to skip to each
+ * occurrence of the first letter and checks the characters around it.
+ *
+ * @param text the block of text to search
+ * @param len  number of bytes in the block
+ * @param pos  offset to start searching from
+ * @param word the word to look for
+ * @param wlen length of the word
+ * @return pointer to the start of the occurrence, or NULL if there is none
+ */
+static const char *scanFrom(const char *text, size_t len, size_t pos, const char *word, size_t wlen)
+{
+    const char *end = text + len;
+    const char *p = text + pos;
+
+    while (p < end && (p = memchr(p, word[0], end - p))){
+        if ((size_t) (end - p) < wlen)
+            return NULL;
+        if ((p == text || delim(p[-1])) && (p + wlen == end || delim(p[wlen]))
+                && memcmp(p, word, wlen) == 0)
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
+/**
+ * Portable kernel.
+ */
+static const char *findScalar(const char *text, size_t len, const char *word, size_t wlen)
+{
+    return scanFrom(text, len, 0, word, wlen);
+}
+
+#ifdef HAVE_X86
+
+/**
+ * Builds the delimiter mask of a 32 byte block: ' ' or a byte in '\t'..'\r'
+ * (checked with one unsigned min after subtracting '\t').
+ */
+__attribute__((target("avx2")))
+static inline uint32_t delimMask256(__m256i blk)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+
+    __m256i ctl = _mm256_sub_epi8(blk, tab);
+    __m256i isCtl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, four), ctl);
+    __m256i isSpace = _mm256_cmpeq_epi8(blk, space);
+    return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(isCtl, isSpace));
+}
+
+/**
+ * AVX2 kernel, 32 bytes per step.
+ */
+__attribute__((target("avx2")))
+static const char *findAvx2(const char *text, size_t len, const char *word, size_t wlen)
+{
+    const __m256i first = _mm256_set1_epi8(word[0]);
+    //the character before the block counts as a delimiter
+    uint32_t carry = 1;
+    size_t i = 0;
+
+    //the block and the bytes just past each candidate must both be in range
+    while (i + 32 + wlen <= len){
+        __m256i blk = _mm256_loadu_si256((const __m256i *) (text + i));
+        __m256i after = _mm256_loadu_si256((const __m256i *) (text + i + wlen));
+
+        uint32_t delims = delimMask256(blk);
+        uint32_t before = (delims << 1) | carry;
+        uint32_t cand = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(blk, first));
+        cand &= before & delimMask256(after);
+        carry = delims >> 31;
+
+        while (cand){
+            size_t at = i + __builtin_ctz(cand);
+            if (memcmp(text + at + 1, word + 1, wlen - 1) == 0)
+                return text + at;
+            cand &= cand - 1;
+        }
+        i += 32;
+    }
+    return scanFrom(text, len, i, word, wlen);
+}
+
+/**
+ * Builds the delimiter mask of a 16 byte block, the same way as the AVX2 kernel.
+ */
+__attribute__((target("sse2")))
+static inline uint32_t delimMask128(__m128i blk)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+
+    __m128i ctl = _mm_sub_epi8(blk, tab);
+    __m128i isCtl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, four), ctl);
+    __m128i isSpace = _mm_cmpeq_epi8(blk, space);
+    return (uint32_t) _mm_movemask_epi8(_mm_or_si128(isCtl, isSpace));
+}
+
+/**
+ * SSE2 kernel, 16 bytes per step.
+ */
+__attribute__((target("sse2")))
+static const char *findSse2(const char *text, size_t len, const char *word, size_t wlen)
+{
+    const __m128i first = _mm_set1_epi8(word[0]);
+    //the character before the block counts as a delimiter
+    uint32_t carry = 1;
+    size_t i = 0;
+
+    //the block and the bytes just past each candidate must both be in range
+    while (i + 16 + wlen <= len){
+        __m128i blk = _mm_loadu_si128((const __m128i *) (text + i));
+        __m128i after = _mm_loadu_si128((const __m128i *) (text + i + wlen));
+
+        uint32_t delims = delimMask128(blk);
+        uint32_t before = ((delims << 1) | carry) & 0xffff;
+        uint32_t cand = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(blk, first));
+        cand &= before & delimMask128(after);
+        carry = delims >> 15;
+
+        while (cand){
+            size_t at = i + __builtin_ctz(cand);
+            if (memcmp(text + at + 1, word + 1, wlen - 1) == 0)
+                return text + at;
+            cand &= cand - 1;
+        }
+        i += 16;
+    }
+    return scanFrom(text, len, i, word, wlen);
+}
+
+FindFunc findKernel(const char *name)
+{
+    __builtin_cpu_init();
+
+    int avx2 = __builtin_cpu_supports("avx2");
+    int sse2 = __builtin_cpu_supports("sse2");
+
+    if (!name)
+        return avx2 ? findAvx2 : sse2 ? findSse2 : findScalar;
+    if (strcmp(name, "avx2") == 0)
+        return avx2 ? findAvx2 : NULL;
+    if (strcmp(name, "sse2") == 0)
+        return sse2 ? findSse2 : NULL;
+    if (strcmp(name, "scalar") == 0)
+        return findScalar;
+    return NULL;
+}
+
+#else
+
+FindFunc findKernel(const char *name)
+{
+    if (!name || strcmp(name, "scalar") == 0)
+        return findScalar;
+    return NULL;
+}
+
+#endif
+
+int useKernel(const char *name)
+{
+    FindFunc kernel = findKernel(name);
+    if (!kernel)
+        return -1;
+
+    current = kernel;
+    currentName = name ? name : "scalar";
+#ifdef HAVE_X86
+    if (!name)
+        currentName = kernel == findAvx2 ? "avx2" : kernel == findSse2 ? "sse2" : "scalar";
+#endif
+    return 0;
+}
+
+const char *kernelName(void)
+{
+    return currentName;
+}
+
+/**
+ * Picks the best kernel before main runs so findWord never has to check.
+ */
+__attribute__((constructor))
+static void pickKernel(void)
+{
+    useKernel(NULL);
+}
+
+const char *findWord(const char *text, size_t len, const char *word, size_t wlen)
+{
+    return current(text, len, word, wlen);
+}
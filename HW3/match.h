@@ -0,0 +1,62 @@
+/**
+ * @author David Hines (dhhines)
+ * @file match.h
+ *
+ * Whole-word match kernels used by the scanning engine.  A kernel finds the first
+ * place in a block of text where the search word appears as a complete word, with
+ * the same semantics as comparing each sscanf("%s") token against the word.
+ *
+ * The AVX2 and SSE2 kernels look for the first byte of the word together with
+ * the whitespace delimiters around it 32 (or 16) bytes at a time and only compare
+ * the candidates that are a whole token of the right length.  The kernel used by
+ * findWord is picked at startup from the features of the CPU, falling back to a
+ * portable scalar kernel.
+ */
+
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <stddef.h>
+
+/**
+ * Finds the first whole-word occurrence of the word.  The character before text is
+ * treated as a delimiter, as is the end of the block.
+ *
+ * @param text the block of text to search
+ * @param len  number of bytes in the block
+ * @param word the word to look for (must not be empty or contain delimiters)
+ * @param wlen length of the word
+ * @return pointer to the start of the occurrence, or NULL if there is none
+ */
+typedef const char *(*FindFunc)(const char *text, size_t len, const char *word, size_t wlen);
+
+/**
+ * Finds the first whole-word occurrence of the word using the selected kernel.
+ * See FindFunc for the parameters.
+ */
+const char *findWord(const char *text, size_t len, const char *word, size_t wlen);
+
+/**
+ * Looks up a kernel by name ("scalar", "sse2" or "avx2").
+ *
+ * @param name the kernel name, or NULL for the best kernel the CPU supports
+ * @return the kernel, or NULL if it is unknown or the CPU doesn't support it
+ */
+FindFunc findKernel(const char *name);
+
+/**
+ * Selects the kernel findWord uses.
+ *
+ * @param name the kernel name, or NULL for the best kernel the CPU supports
+ * @return 0 on success, -1 if the kernel is unknown or not supported
+ */
+int useKernel(const char *name);
+
+/**
+ * Returns the name of the kernel findWord is currently using.
+ *
+ * @return the kernel name
+ */
+const char *kernelName(void);
+
+#endif
@@ -0,0 +1,213 @@
+/**
+ * @author David Hines (dhhines)
+ * @file matchbench.c
+ *
+ * Microbenchmark for the whole-word match kernels.  The sample text files are
+ * repeated in memory until the buffer reaches the requested size, then the buffer
+ * is searched with the original readLine/sscanf/strcmp path (read through fmemopen
+ * so it pays the same per-character stdio cost as the old find programs) and with
+ * each match kernel the CPU supports.  Throughput and the number of matching lines
+ * are printed for each so the kernels can be checked against the original.
+ *
+ * Compilation: use provided Makefile
+ *              -usage: "make matchbench"
+ *
+ * Usage: ./matchbench [-s megabytes] [-w word] [-n] [file]...
+ *        -n skips the (slow) original path; files default to text1.txt - text5.txt
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "scan.h"
+#include "match.h"
+
+//initial capacity of the line buffer
+#define INIT_CPCTY 10
+//standard multiplier for increasing size of line buffer
+#define STD_INCRMT 2
+//maximum word size
+#define MAX_BUFFER 200
+
+/**
+ * The original line reader from find.c, kept here as the baseline.
+ *
+ * @param *fp pointer to the input file stream to be parsed
+ * @return pointer to the dynamic memory block holding the text of a single line
+ */
+char *readLine(FILE *fp)
+{
+    int capacity = INIT_CPCTY;
+    char *buffer = (char *) malloc (capacity * sizeof(char) + 1);
+    int len = 0;
+    char ch;
+    int matches = 0;
+
+    while ((matches = (fscanf(fp, "%c", &ch) == 1))){
+        if (len >= capacity){
+            capacity *= STD_INCRMT;
+            buffer = (char *) realloc (buffer, capacity * sizeof(char) + 1);
+            if (!buffer)
+                exit(EXIT_FAILURE);
+        }
+        if (ch != '\n')
+            buffer[len++] = ch;
+        else
+            break;
+    }
+
+    //unlike the original, keep a last line that has no newline so the counts agree
+    if (matches > 0 || len > 0){
+        buffer[len] = '\0';
+        return buffer;
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * Counts matching lines with the original readLine + sscanf("%s") + strcmp loop.
+ *
+ * @param data the text to search
+ * @param size number of bytes of text
+ * @param word the word to search for
+ * @return number of matching lines
+ */
+long originalSearch(char *data, size_t size, const char *word)
+{
+    FILE *fp = fmemopen(data, size, "r");
+    char *linetext;
+    char tempWord[MAX_BUFFER];
+    int val = 0;
+    int cursor = 0;
+    long found = 0;
+
+    while ((linetext = readLine(fp))){
+        while ((sscanf(linetext + cursor, "%199s%n", tempWord, &val)) != EOF){
+            cursor += val;
+            if (strcmp(word, tempWord) == 0){
+                found++;
+                break;
+            }
+        }
+        cursor = 0;
+        free(linetext);
+    }
+    fclose(fp);
+    return found;
+}
+
+/**
+ * Match callback that does nothing; scanLines already counts the lines.
+ */
+void ignoreMatch(const char *text, Slice line, const int *ids, int numIds, void *ctx)
+{
+    (void) text;
+    (void) line;
+    (void) ids;
+    (void) numIds;
+    (void) ctx;
+}
+
+/**
+ * Returns the current monotonic time in seconds.
+ */
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Prints one result line of the benchmark table.
+ */
+void report(const char *name, double secs, size_t size, long found)
+{
+    printf("%-10s %9.3f s %10.1f MB/s %12ld lines\n", name, secs, size / secs / (1024 * 1024), found);
+}
+
+/**
+ * Main program for the match kernel benchmark
+ * @param argc the number of arguments passed from commandline
+ * @param argv array of character pointers to the argurments entered on the commandline
+ */
+int main(int argc, char *argv[])
+{
+    static char *defaults[] = { "text1.txt", "text2.txt", "text3.txt", "text4.txt", "text5.txt" };
+    static const char *kernels[] = { "scalar", "sse2", "avx2" };
+    size_t size = 1024UL * 1024 * 1024;
+    const char *word = "funny";
+    int original = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:w:n")) != -1){
+        switch (opt){
+        case 's':
+            size = strtoul(optarg, NULL, 10) * 1024 * 1024;
+            break;
+        case 'w':
+            word = optarg;
+            break;
+        case 'n':
+            original = 0;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s megabytes] [-w word] [-n] [file]...\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    char **files = optind < argc ? argv + optind : defaults;
+    int numFiles = optind < argc ? argc - optind : 5;
+
+    //repeat the sample files end to end until the buffer is full
+    char *data = (char *) malloc(size);
+    size_t len = 0;
+    while (len < size){
+        size_t before = len;
+        for (int i = 0; i < numFiles && len < size; i++){
+            Source src;
+            if (openSource(&src, files[i]) < 0 || !src.mapped){
+                fprintf(stderr, "Can't map file %s\n", files[i]);
+                exit(EXIT_FAILURE);
+            }
+            size_t n = src.size < size - len ? src.size : size - len;
+            memcpy(data + len, src.data, n);
+            len += n;
+            //keep the files on separate lines
+            if (len < size && n > 0 && data[len - 1] != '\n')
+                data[len++] = '\n';
+            closeSource(&src);
+        }
+        if (len == before){
+            fprintf(stderr, "Sample files are empty\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("searching %zu MB for \"%s\"\n", size / (1024 * 1024), word);
+
+    if (original){
+        double start = now();
+        long found = originalSearch(data, size, word);
+        report("sscanf", now() - start, size, found);
+    }
+
+    Query query = { word, NULL };
+    for (int i = 0; i < 3; i++){
+        if (useKernel(kernels[i]) < 0){
+            printf("%-10s not supported\n", kernels[i]);
+            continue;
+        }
+        double start = now();
+        long found = scanLines(data, size, 0, size, 0, &query, ignoreMatch, NULL);
+        report(kernels[i], now() - start, size, found);
+    }
+
+    free(data);
+    return EXIT_SUCCESS;
+}
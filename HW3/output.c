@@ -0,0 +1,391 @@
+/**
+ * @author David Hines (dhhines)
+ * @file output.c
+ *
+ * Implementation of the streaming output stage (see output.h).  Each job has a
+ * list of submitted batches.  The writer thread takes the whole list of the job at
+ * the head of the output order, writes it with as few writev calls as possible and
+ * moves on to the next job once the head job is finished and drained.
+ */
+
+#include "output.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+//initial capacity of a batch
+#define INIT_CPCTY 256
+//standard multiplier for increasing size of a batch
+#define STD_INCRMT 2
+//most batches gathered into one writev call
+#define MAX_IOV 64
+
+//a submitted batch waiting to be written
+typedef struct Chunk_Struct {
+    char *data;
+    size_t len;
+    struct Chunk_Struct *next;
+} Chunk;
+
+struct Output_Struct {
+    int fd;
+    int numSeqs;
+    int numWorkers;
+    size_t memCap;
+    Chunk **first;  //queued batches of each job
+    Chunk **last;  //last queued batch of each job
+    char *done;  //1 once a job has been finished
+    int head;  //job currently being written
+    size_t queued;  //bytes in all queued batches
+    int waiting;  //workers held back by the memory cap
+    int failed;  //1 once a write has failed
+    pthread_mutex_t lock;
+    pthread_cond_t ready;  //signalled when a batch is queued or a job finishes
+    pthread_cond_t drained;  //broadcast when the writer frees memory or moves on
+    pthread_t writer;
+};
+
+int parseFormat(const char *name, OutputFormat *fmt)
+{
+    if (strcmp(name, "text") == 0)
+        *fmt = FORMAT_TEXT;
+    else if (strcmp(name, "json") == 0)
+        *fmt = FORMAT_JSON;
+    else if (strcmp(name, "binary") == 0)
+        *fmt = FORMAT_BINARY;
+    else
+        return -1;
+    return 0;
+}
+
+/**
+ * Makes sure the batch has room for more bytes.
+ *
+ * @param batch the batch to grow
+ * @param more  number of bytes about to be appended
+ */
+static void reserveBatch(Batch *batch, size_t more)
+{
+    size_t need = batch->len + more;
+
+    if (need > batch->capacity){
+        size_t capacity = batch->capacity ? batch->capacity : INIT_CPCTY;
+        while (capacity < need)
+            capacity *= STD_INCRMT;
+        batch->data = (char *) realloc(batch->data, capacity);
+        if (!batch->data)
+            exit(EXIT_FAILURE);
+        batch->capacity = capacity;
+    }
+}
+
+void appendBatch(Batch *batch, const void *text, size_t len)
+{
+    reserveBatch(batch, len);
+    memcpy(batch->data + batch->len, text, len);
+    batch->len += len;
+}
+
+/**
+ * Appends a JSON string (quotes included) to the batch.  Bytes that are not
+ * control characters are copied as they are.
+ *
+ * @param batch the batch to append to
+ * @param text  the string
+ * @param len   number of bytes in the string
+ */
+static void appendJsonString(Batch *batch, const char *text, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t from = 0;
+
+    appendBatch(batch, "\"", 1);
+    for (size_t i = 0; i < len; i++){
+        unsigned char ch = (unsigned char) text[i];
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;
+
+        //copy the plain run before the escape in one go
+        appendBatch(batch, text + from, i - from);
+        from = i + 1;
+        if (ch == '"' || ch == '\\'){
+            char esc[2] = { '\\', (char) ch };
+            appendBatch(batch, esc, 2);
+        }
+        else if (ch == '\t')
+            appendBatch(batch, "\\t", 2);
+        else if (ch == '\r')
+            appendBatch(batch, "\\r", 2);
+        else {
+            char esc[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 15] };
+            appendBatch(batch, esc, 6);
+        }
+    }
+    appendBatch(batch, text + from, len - from);
+    appendBatch(batch, "\"", 1);
+}
+
+void formatRecord(Batch *batch, OutputFormat fmt, const Record *rec)
+{
+    char num[64];
+    int nlen;
+
+    if (fmt == FORMAT_TEXT){
+        nlen = snprintf(num, sizeof(num), "%s: %d  ", rec->label, rec->id);
+        appendBatch(batch, num, nlen);
+        for (int i = 0; i < rec->numIds; i++){
+            const char *word = queryWord(rec->query, rec->ids[i]);
+            if (i > 0)
+                appendBatch(batch, ",", 1);
+            appendBatch(batch, word, strlen(word));
+        }
+        appendBatch(batch, ": ", 2);
+        appendBatch(batch, rec->text, rec->line.length);
+        appendBatch(batch, "\n", 1);
+    }
+    else if (fmt == FORMAT_JSON){
+        appendBatch(batch, "{\"file\":", 8);
+        appendJsonString(batch, rec->file, strlen(rec->file));
+        nlen = snprintf(num, sizeof(num), ",\"offset\":%lld,\"%s\":%d,\"words\":[",
+                        (long long) rec->line.offset, rec->key, rec->id);
+        appendBatch(batch, num, nlen);
+        for (int i = 0; i < rec->numIds; i++){
+            const char *word = queryWord(rec->query, rec->ids[i]);
+            if (i > 0)
+                appendBatch(batch, ",", 1);
+            appendJsonString(batch, word, strlen(word));
+        }
+        appendBatch(batch, "],\"line\":", 9);
+        appendJsonString(batch, rec->text, rec->line.length);
+        appendBatch(batch, "}\n", 2);
+    }
+    else {
+        static const char zeros[8];
+        RecordHeader hdr;
+        size_t start = batch->len;
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.id = (uint32_t) rec->id;
+        hdr.offset = (uint64_t) rec->line.offset;
+        hdr.fileLen = (uint32_t) strlen(rec->file);
+        hdr.numWords = (uint32_t) rec->numIds;
+        hdr.lineLen = (uint32_t) rec->line.length;
+        for (int i = 0; i < rec->numIds; i++)
+            hdr.wordsLen += (uint32_t) strlen(queryWord(rec->query, rec->ids[i])) + 1;
+        size_t body = sizeof(hdr) + hdr.fileLen + hdr.wordsLen + hdr.lineLen;
+        hdr.length = (uint32_t) ((body + 7) & ~(size_t) 7);
+
+        reserveBatch(batch, hdr.length);
+        appendBatch(batch, &hdr, sizeof(hdr));
+        appendBatch(batch, rec->file, hdr.fileLen);
+        for (int i = 0; i < rec->numIds; i++){
+            const char *word = queryWord(rec->query, rec->ids[i]);
+            appendBatch(batch, word, strlen(word) + 1);
+        }
+        appendBatch(batch, rec->text, hdr.lineLen);
+        appendBatch(batch, zeros, start + hdr.length - batch->len);
+    }
+}
+
+int writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0){
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+/**
+ * Writes a list of batches with writev and frees them.
+ *
+ * @param out  the output stage
+ * @param list the batches, in order
+ * @return number of bytes the batches held
+ */
+static size_t writeChunks(Output *out, Chunk *list)
+{
+    struct iovec iov[MAX_IOV];
+    size_t total = 0;
+
+    while (list){
+        //gather up to MAX_IOV batches
+        int count = 0;
+        size_t bytes = 0;
+        for (Chunk *c = list; c && count < MAX_IOV; c = c->next){
+            iov[count].iov_base = c->data;
+            iov[count].iov_len = c->len;
+            bytes += c->len;
+            count++;
+        }
+
+        //write them, stepping over whatever a short write left behind
+        struct iovec *vec = iov;
+        int left = count;
+        while (left > 0 && !out->failed){
+            ssize_t n = writev(out->fd, vec, left);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0){
+                out->failed = 1;
+                break;
+            }
+            while (left > 0 && (size_t) n >= vec->iov_len){
+                n -= vec->iov_len;
+                vec++;
+                left--;
+            }
+            if (left > 0){
+                vec->iov_base = (char *) vec->iov_base + n;
+                vec->iov_len -= n;
+            }
+        }
+
+        for (int i = 0; i < count; i++){
+            Chunk *next = list->next;
+            free(list->data);
+            free(list);
+            list = next;
+        }
+        total += bytes;
+    }
+    return total;
+}
+
+/**
+ * Writer thread: writes the jobs' batches in sequence order until every job has
+ * been finished and written.
+ *
+ * @param arg the output stage
+ * @return NULL
+ */
+static void *writerThread(void *arg)
+{
+    Output *out = (Output *) arg;
+
+    pthread_mutex_lock(&out->lock);
+    while (out->head < out->numSeqs){
+        Chunk *list = out->first[out->head];
+
+        if (list){
+            out->first[out->head] = out->last[out->head] = NULL;
+            pthread_mutex_unlock(&out->lock);
+            size_t bytes = writeChunks(out, list);
+            pthread_mutex_lock(&out->lock);
+            out->queued -= bytes;
+            pthread_cond_broadcast(&out->drained);
+        }
+        else if (out->done[out->head]){
+            out->head++;
+            pthread_cond_broadcast(&out->drained);
+        }
+        else
+            pthread_cond_wait(&out->ready, &out->lock);
+    }
+    pthread_mutex_unlock(&out->lock);
+    return NULL;
+}
+
+Output *createOutput(int fd, int numSeqs, int numWorkers, size_t memCap)
+{
+    Output *out = (Output *) calloc(1, sizeof(Output));
+    if (!out)
+        exit(EXIT_FAILURE);
+
+    out->fd = fd;
+    out->numSeqs = numSeqs;
+    out->numWorkers = numWorkers;
+    out->memCap = memCap;
+    out->first = (Chunk **) calloc(numSeqs + 1, sizeof(Chunk *));
+    out->last = (Chunk **) calloc(numSeqs + 1, sizeof(Chunk *));
+    out->done = (char *) calloc(numSeqs + 1, 1);
+    if (!out->first || !out->last || !out->done)
+        exit(EXIT_FAILURE);
+
+    pthread_mutex_init(&out->lock, NULL);
+    pthread_cond_init(&out->ready, NULL);
+    pthread_cond_init(&out->drained, NULL);
+    if (pthread_create(&out->writer, NULL, writerThread, out) != 0){
+        fprintf(stderr, "Can't create writer thread\n");
+        exit(EXIT_FAILURE);
+    }
+    return out;
+}
+
+/**
+ * Queues a batch for a job; called with the lock held.  The batch is left empty.
+ */
+static void queueBatch(Output *out, int seq, Batch *batch)
+{
+    if (batch->len == 0)
+        return;
+
+    Chunk *c = (Chunk *) malloc(sizeof(Chunk));
+    if (!c)
+        exit(EXIT_FAILURE);
+    c->data = batch->data;
+    c->len = batch->len;
+    c->next = NULL;
+    batch->data = NULL;
+    batch->len = 0;
+    batch->capacity = 0;
+
+    if (out->last[seq])
+        out->last[seq]->next = c;
+    else
+        out->first[seq] = c;
+    out->last[seq] = c;
+    out->queued += c->len;
+}
+
+void submitBatch(Output *out, int seq, Batch *batch)
+{
+    pthread_mutex_lock(&out->lock);
+
+    //hold back workers that are ahead of the writer while too much is queued, but
+    //never the last one running so the job the writer waits for can still finish
+    while (out->queued >= out->memCap && seq != out->head && out->waiting + 1 < out->numWorkers){
+        out->waiting++;
+        pthread_cond_wait(&out->drained, &out->lock);
+        out->waiting--;
+    }
+
+    queueBatch(out, seq, batch);
+    if (seq == out->head)
+        pthread_cond_signal(&out->ready);
+    pthread_mutex_unlock(&out->lock);
+}
+
+void finishSeq(Output *out, int seq, Batch *batch)
+{
+    pthread_mutex_lock(&out->lock);
+    queueBatch(out, seq, batch);
+    out->done[seq] = 1;
+    if (seq == out->head)
+        pthread_cond_signal(&out->ready);
+    pthread_mutex_unlock(&out->lock);
+}
+
+int closeOutput(Output *out)
+{
+    pthread_join(out->writer, NULL);
+    int status = out->failed ? -1 : 0;
+
+    pthread_mutex_destroy(&out->lock);
+    pthread_cond_destroy(&out->ready);
+    pthread_cond_destroy(&out->drained);
+    free(out->first);
+    free(out->last);
+    free(out->done);
+    free(out);
+    return status;
+}
@@ -0,0 +1,146 @@
+/**
+ * @author David Hines (dhhines)
+ * @file output.h
+ *
+ * Streaming output stage shared by find and find2.  Matching lines are formatted
+ * into a private batch by whoever found them (a worker thread or a child process)
+ * and only whole batches are handed on, so nothing is locked per line.  In find2 a
+ * single writer thread puts the batches of each job out in job order with writev;
+ * workers that run ahead of the writer are held back once the queued batches reach
+ * a memory cap, which keeps memory bounded no matter how large the input is.
+ *
+ * Besides the human readable text format, matches can be written as NDJSON (one
+ * JSON object per line) or as binary records so that other tools don't have to
+ * parse the text.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "scan.h"
+
+//size a batch grows to before it is handed to the writer
+#define BATCH_SIZE (64 * 1024)
+
+//formats matches can be written in
+typedef enum {
+    FORMAT_TEXT,  //"TID: <id>  <words>: <line>"
+    FORMAT_JSON,  //one JSON object per line
+    FORMAT_BINARY  //RecordHeader followed by its strings
+} OutputFormat;
+
+//header of a binary record.  It is followed by the file name, the words found
+//(each NUL terminated) and the line, then padded to a multiple of 8 bytes.  All
+//fields are in native byte order.
+typedef struct RecordHeader_Struct {
+    uint32_t length;  //bytes in the whole record, padding included
+    uint32_t id;  //thread or process id of the searcher
+    uint64_t offset;  //offset of the line in the file
+    uint32_t fileLen;  //bytes in the file name (without NUL)
+    uint32_t wordsLen;  //bytes of words (with their NULs)
+    uint32_t numWords;
+    uint32_t lineLen;  //bytes in the line
+} RecordHeader;
+
+//a matching line to be formatted
+typedef struct Record_Struct {
+    const char *file;  //name of the file the line is in
+    const char *label;  //"TID" or "PID", for text output
+    const char *key;  //"tid" or "pid", the JSON key of the id
+    int id;  //thread or process id of the searcher
+    const Query *query;  //query the ids refer to
+    const int *ids;  //ids of the words found on the line
+    int numIds;
+    const char *text;  //first character of the line
+    Slice line;  //offset and length of the line
+} Record;
+
+//growable buffer of formatted output
+typedef struct Batch_Struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} Batch;
+
+typedef struct Output_Struct Output;
+
+/**
+ * Looks up an output format by name ("text", "json" or "binary").
+ *
+ * @param name the format name
+ * @param fmt  set to the format
+ * @return 0 on success, -1 if the name is unknown
+ */
+int parseFormat(const char *name, OutputFormat *fmt);
+
+/**
+ * Appends bytes to a batch.
+ *
+ * @param batch the batch to append to
+ * @param text  the bytes to append
+ * @param len   number of bytes
+ */
+void appendBatch(Batch *batch, const void *text, size_t len);
+
+/**
+ * Appends one record to a batch in the given format.
+ *
+ * @param batch the batch to append to
+ * @param fmt   the output format
+ * @param rec   the matching line
+ */
+void formatRecord(Batch *batch, OutputFormat fmt, const Record *rec);
+
+/**
+ * Writes all of a buffer to a file descriptor, retrying short writes.
+ *
+ * @param fd   the file descriptor
+ * @param data the bytes to write
+ * @param len  number of bytes
+ * @return 0 on success, -1 on error
+ */
+int writeAll(int fd, const char *data, size_t len);
+
+/**
+ * Creates the output stage and starts its writer thread.
+ *
+ * @param fd         file descriptor the output is written to
+ * @param numSeqs    number of jobs; their output is written in sequence order
+ * @param numWorkers number of threads submitting batches
+ * @param memCap     bytes of queued batches above which workers are held back
+ * @return the new output stage
+ */
+Output *createOutput(int fd, int numSeqs, int numWorkers, size_t memCap);
+
+/**
+ * Hands a batch to the writer for the given job; the batch is left empty.  If the
+ * queued output is over the memory cap the caller waits until the writer catches
+ * up, unless the job is the one being written or every other worker is already
+ * waiting (so the job the writer needs can always run).
+ *
+ * @param out   the output stage
+ * @param seq   sequence number of the job the batch belongs to
+ * @param batch the batch to hand over
+ */
+void submitBatch(Output *out, int seq, Batch *batch);
+
+/**
+ * Hands over the last batch of a job and marks the job finished.
+ *
+ * @param out   the output stage
+ * @param seq   sequence number of the job
+ * @param batch the final batch (may be empty); left empty
+ */
+void finishSeq(Output *out, int seq, Batch *batch);
+
+/**
+ * Waits for the writer to write every job and frees the output stage.
+ *
+ * @param out the output stage
+ * @return 0 on success, -1 if a write failed
+ */
+int closeOutput(Output *out);
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * @author David Hines (dhhines)
+ * @file pool.c
+ *
+ * Implementation of the work-stealing thread pool (see pool.h).  Each deque has its
+ * own mutex; the owner only contends with a thief when it is stealing from it, so
+ * the common path is an uncontended lock.
+ */
+
+#include "pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+//initial capacity of each worker deque
+#define INIT_CPCTY 16
+//standard multiplier for increasing size of a deque
+#define STD_INCRMT 2
+
+//double ended queue of jobs owned by one worker
+typedef struct Deque_Struct {
+    pthread_mutex_t lock;
+    Job **jobs;  //circular array of jobs
+    int head;  //index of the front job
+    int count;  //number of jobs in the deque
+    int capacity;  //size of the jobs array
+} Deque;
+
+//state handed to each worker thread
+typedef struct Worker_Struct {
+    Pool *pool;
+    int id;
+} Worker;
+
+struct Pool_Struct {
+    int numWorkers;
+    pthread_t *threads;
+    Worker *workers;
+    Deque *deques;
+    JobFunc run;
+    void *ctx;
+};
+
+int numCores(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int) cores : 1;
+}
+
+Pool *createPool(int numWorkers, JobFunc run, void *ctx)
+{
+    Pool *pool = (Pool *) malloc(sizeof(Pool));
+    if (!pool)
+        exit(EXIT_FAILURE);
+
+    pool->numWorkers = numWorkers;
+    pool->run = run;
+    pool->ctx = ctx;
+    pool->threads = (pthread_t *) malloc(numWorkers * sizeof(pthread_t));
+    pool->workers = (Worker *) malloc(numWorkers * sizeof(Worker));
+    pool->deques = (Deque *) malloc(numWorkers * sizeof(Deque));
+    if (!pool->threads || !pool->workers || !pool->deques)
+        exit(EXIT_FAILURE);
+
+    for (int i = 0; i < numWorkers; i++){
+        Deque *dq = &pool->deques[i];
+        pthread_mutex_init(&dq->lock, NULL);
+        dq->capacity = INIT_CPCTY;
+        dq->head = 0;
+        dq->count = 0;
+        dq->jobs = (Job **) malloc(dq->capacity * sizeof(Job *));
+        if (!dq->jobs)
+            exit(EXIT_FAILURE);
+    }
+    return pool;
+}
+
+void submitJob(Pool *pool, int worker, Job *job)
+{
+    Deque *dq = &pool->deques[worker];
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count == dq->capacity){
+        //unroll the circular array into the front of the larger one
+        Job **grown = (Job **) malloc(dq->capacity * STD_INCRMT * sizeof(Job *));
+        if (!grown)
+            exit(EXIT_FAILURE);
+        for (int i = 0; i < dq->count; i++)
+            grown[i] = dq->jobs[(dq->head + i) % dq->capacity];
+        free(dq->jobs);
+        dq->jobs = grown;
+        dq->head = 0;
+        dq->capacity *= STD_INCRMT;
+    }
+    dq->jobs[(dq->head + dq->count) % dq->capacity] = job;
+    dq->count++;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+/**
+ * Takes the job at the front of a worker's own deque.
+ *
+ * @param dq the worker's deque
+ * @return the job, or NULL if the deque is empty
+ */
+static Job *popFront(Deque *dq)
+{
+    Job *job = NULL;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0){
+        job = dq->jobs[dq->head];
+        dq->head = (dq->head + 1) % dq->capacity;
+        dq->count--;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return job;
+}
+
+/**
+ * Steals the job at the back of another worker's deque.
+ *
+ * @param dq the victim's deque
+ * @return the job, or NULL if the deque is empty
+ */
+static Job *stealBack(Deque *dq)
+{
+    Job *job = NULL;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0){
+        dq->count--;
+        job = dq->jobs[(dq->head + dq->count) % dq->capacity];
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return job;
+}
+
+/**
+ * Worker thread body.  Runs jobs from its own deque, then steals from the other
+ * workers (starting with its neighbor) until every deque is empty.  No jobs are
+ * added once the pool is running, so a full pass over empty deques means the
+ * work is done.
+ *
+ * @param param pointer to the Worker for this thread
+ */
+static void *workerLoop(void *param)
+{
+    Worker *self = (Worker *)param;
+    Pool *pool = self->pool;
+    Job *job;
+
+    while (1){
+        job = popFront(&pool->deques[self->id]);
+
+        for (int i = 1; !job && i < pool->numWorkers; i++)
+            job = stealBack(&pool->deques[(self->id + i) % pool->numWorkers]);
+
+        if (!job)
+            break;
+        pool->run(job, self->id, pool->ctx);
+    }
+    return NULL;
+}
+
+void startPool(Pool *pool)
+{
+    for (int i = 0; i < pool->numWorkers; i++){
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->threads[i], NULL, workerLoop, &pool->workers[i]) != 0){
+            fprintf(stderr, "Can't create worker thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void joinPool(Pool *pool)
+{
+    for (int i = 0; i < pool->numWorkers; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    for (int i = 0; i < pool->numWorkers; i++){
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].jobs);
+    }
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
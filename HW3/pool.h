@@ -0,0 +1,78 @@
+/**
+ * @author David Hines (dhhines)
+ * @file pool.h
+ *
+ * Fixed size work-stealing thread pool used by find2.  Every worker owns a deque of
+ * jobs.  A worker takes jobs from the front of its own deque (lowest sequence number
+ * first, which keeps the merge stage busy) and, once its deque runs dry, steals from
+ * the back of the other workers' deques so one large file can't leave cores idle.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+//a unit of work: a byte range of one input file
+typedef struct Job_Struct {
+    int seq;  //position of the job in the output order
+    int file;  //index of the file the range belongs to
+    size_t start;  //first byte of the range
+    size_t end;  //one past the last byte of the range
+} Job;
+
+/**
+ * Function the workers call for each job they take.
+ *
+ * @param job    the job to run
+ * @param worker index of the worker running the job
+ * @param ctx    context pointer given to startPool
+ */
+typedef void (*JobFunc)(Job *job, int worker, void *ctx);
+
+typedef struct Pool_Struct Pool;
+
+/**
+ * Returns the number of online processors, used as the default pool size.
+ *
+ * @return number of cores (at least 1)
+ */
+int numCores(void);
+
+/**
+ * Creates a pool with the given number of workers.  No threads are started until
+ * startPool is called.
+ *
+ * @param numWorkers number of worker threads
+ * @param run        function run for every job
+ * @param ctx        context pointer passed to run
+ * @return the new pool
+ */
+Pool *createPool(int numWorkers, JobFunc run, void *ctx);
+
+/**
+ * Adds a job to the back of a worker's deque.  Jobs must all be submitted before
+ * the pool is started.
+ *
+ * @param pool   the pool
+ * @param worker worker whose deque receives the job
+ * @param job    the job to add
+ */
+void submitJob(Pool *pool, int worker, Job *job);
+
+/**
+ * Starts the worker threads.  Each worker exits once every deque is empty.
+ *
+ * @param pool the pool to start
+ */
+void startPool(Pool *pool);
+
+/**
+ * Waits for all workers to finish and frees the pool.
+ *
+ * @param pool the pool to join
+ */
+void joinPool(Pool *pool);
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * @author David Hines (dhhines)
+ * @file ring.c
+ *
+ * Implementation of the shared SPSC byte ring (see ring.h).  The head and tail
+ * are free running byte counts, each on its own cache line; the data offset is the
+ * count masked by the ring size.
+ */
+
+#include "ring.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+//bytes in a cache line, used to keep the head and tail apart
+#define CACHE_LINE 64
+
+struct Ring_Struct {
+    uint64_t head;  //bytes read, only written by the reader
+    char padHead[CACHE_LINE - sizeof(uint64_t)];
+    uint64_t tail;  //bytes written, only written by the writer
+    char padTail[CACHE_LINE - sizeof(uint64_t)];
+    uint64_t size;  //bytes of data (a power of two)
+    char padSize[CACHE_LINE - sizeof(uint64_t)];
+    char data[];
+};
+
+Ring *createRing(size_t size)
+{
+    size_t capacity = CACHE_LINE;
+    while (capacity < size)
+        capacity *= 2;
+
+    Ring *ring = mmap(NULL, sizeof(Ring) + capacity, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED){
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->size = capacity;
+    return ring;
+}
+
+void freeRing(Ring *ring)
+{
+    munmap(ring, sizeof(Ring) + ring->size);
+}
+
+void resetRing(Ring *ring)
+{
+    __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->tail, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies bytes into the ring at a byte count, wrapping at the end of the data.
+ */
+static void copyIn(Ring *ring, uint64_t pos, const void *src, size_t len)
+{
+    size_t off = (size_t) (pos & (ring->size - 1));
+    size_t first = ring->size - off < len ? ring->size - off : len;
+
+    memcpy(ring->data + off, src, first);
+    memcpy(ring->data, (const char *) src + first, len - first);
+}
+
+int ringPut(Ring *ring, const void *hdr, size_t hdrLen, const void *body, size_t bodyLen)
+{
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (ring->size - (tail - head) < hdrLen + bodyLen)
+        return -1;
+
+    copyIn(ring, tail, hdr, hdrLen);
+    copyIn(ring, tail + hdrLen, body, bodyLen);
+
+    //publish the whole message at once
+    __atomic_store_n(&ring->tail, tail + hdrLen + bodyLen, __ATOMIC_RELEASE);
+    return 0;
+}
+
+size_t ringUsed(Ring *ring)
+{
+    return (size_t) (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - ring->head);
+}
+
+void ringGet(Ring *ring, void *dst, size_t len)
+{
+    uint64_t head = ring->head;
+    size_t off = (size_t) (head & (ring->size - 1));
+    size_t first = ring->size - off < len ? ring->size - off : len;
+
+    memcpy(dst, ring->data + off, first);
+    memcpy((char *) dst + first, ring->data, len - first);
+
+    //hand the space back to the writer
+    __atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,77 @@
+/**
+ * @author David Hines (dhhines)
+ * @file ring.h
+ *
+ * Single producer, single consumer byte ring in shared memory, used by the find
+ * worker processes to send results to the parent.  The ring is mapped MAP_SHARED
+ * before fork so both processes see the same memory.  The writer only moves the
+ * tail and the reader only moves the head, so neither side takes a lock; each side
+ * publishes its position with a release store and reads the other's with an
+ * acquire load.
+ *
+ * The ring carries messages: a message is written whole or not at all, so once
+ * the reader sees any of it the rest is there too.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Ring_Struct Ring;
+
+/**
+ * Maps a new shared ring.
+ *
+ * @param size bytes of data the ring holds (rounded up to a power of two)
+ * @return the new ring
+ */
+Ring *createRing(size_t size);
+
+/**
+ * Unmaps a ring.
+ *
+ * @param ring the ring to free
+ */
+void freeRing(Ring *ring);
+
+/**
+ * Empties a ring.  Only safe while neither side is using it.
+ *
+ * @param ring the ring to reset
+ */
+void resetRing(Ring *ring);
+
+/**
+ * Writes one message made of a header and a body.  Fails without writing
+ * anything if the ring doesn't have room for both.
+ *
+ * @param ring    the ring
+ * @param hdr     the message header
+ * @param hdrLen  bytes in the header
+ * @param body    the message body
+ * @param bodyLen bytes in the body
+ * @return 0 on success, -1 if the ring is too full
+ */
+int ringPut(Ring *ring, const void *hdr, size_t hdrLen, const void *body, size_t bodyLen);
+
+/**
+ * Returns the number of bytes waiting to be read.
+ *
+ * @param ring the ring
+ * @return bytes available to the reader
+ */
+size_t ringUsed(Ring *ring);
+
+/**
+ * Reads bytes from the ring.  The caller must have seen at least len bytes in
+ * ringUsed.
+ *
+ * @param ring the ring
+ * @param dst  where to copy the bytes
+ * @param len  number of bytes to read
+ */
+void ringGet(Ring *ring, void *dst, size_t len);
+
+#endif
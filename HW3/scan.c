@@ -0,0 +1,231 @@
+/**
+ * @author David Hines (dhhines)
+ * @file scan.c
+ *
+ * Implementation of the zero-copy scanning engine (see scan.h).  Regular files are
+ * mapped with mmap() and scanned in place.  Other sources are read with read() into
+ * a window that only ever holds whole lines plus the unfinished tail, so memory use
+ * is bounded by the longest line rather than the size of the stream.  The search
+ * itself is done by the match kernels (see match.h) over whole blocks of lines.
+ */
+
+#include "scan.h"
+#include "match.h"
+#include "aho.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//initial capacity of the read() window
+#define WINDOW_CPCTY (64 * 1024)
+//standard multiplier for increasing size of the read() window
+#define STD_INCRMT 2
+
+int openSource(Source *src, const char *name)
+{
+    struct stat st;
+
+    memset(src, 0, sizeof(Source));
+    src->name = name;
+
+    if (strcmp(name, STDIN_NAME) == 0)
+        src->fd = STDIN_FILENO;
+    else if ((src->fd = open(name, O_RDONLY)) < 0)
+        return -1;
+
+    if (fstat(src->fd, &st) < 0){
+        closeSource(src);
+        return -1;
+    }
+
+    //regular files are mapped whole; an empty file has nothing to map
+    if (S_ISREG(st.st_mode)){
+        src->mapped = 1;
+        src->size = (size_t) st.st_size;
+        if (src->size > 0){
+            src->data = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, src->fd, 0);
+            if (src->data == MAP_FAILED){
+                src->data = NULL;
+                closeSource(src);
+                return -1;
+            }
+            madvise(src->data, src->size, MADV_SEQUENTIAL);
+        }
+        //the mapping stays valid after the descriptor is closed
+        if (src->fd != STDIN_FILENO)
+            close(src->fd);
+        src->fd = -1;
+        return 0;
+    }
+
+    src->capacity = WINDOW_CPCTY;
+    src->data = (char *) malloc(src->capacity);
+    if (!src->data){
+        closeSource(src);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+void closeSource(Source *src)
+{
+    if (src->mapped){
+        if (src->data)
+            munmap(src->data, src->size);
+    }
+    else
+        free(src->data);
+
+    if (src->fd > STDIN_FILENO)
+        close(src->fd);
+
+    src->data = NULL;
+    src->fd = -1;
+}
+
+int isDelim(char ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+/**
+ * Checks that the word could ever equal a token: it must not be empty and must
+ * not contain a delimiter.
+ *
+ * @param word the word to check
+ * @param wlen length of the word
+ * @return 1 if the word can match, 0 otherwise
+ */
+static int validWord(const char *word, size_t wlen)
+{
+    if (wlen == 0)
+        return 0;
+    for (size_t i = 0; i < wlen; i++)
+        if (isDelim(word[i]))
+            return 0;
+    return 1;
+}
+
+size_t lineStart(const char *data, size_t size, size_t pos)
+{
+    if (pos == 0 || pos >= size || data[pos - 1] == '\n')
+        return pos < size ? pos : size;
+
+    const char *nl = memchr(data + pos, '\n', size - pos);
+    return nl ? (size_t) (nl - data) + 1 : size;
+}
+
+const char *queryWord(const Query *query, int id)
+{
+    return query->ac ? patternText(query->ac, id) : query->word;
+}
+
+long scanLines(const char *data, size_t size, size_t start, size_t end, off_t base,
+               const Query *query, MatchFunc onMatch, void *ctx)
+{
+    static const int wordId = 0;
+
+    if (query->ac)
+        return acScanLines(query->ac, data, size, start, end, base, onMatch, ctx);
+
+    const char *word = query->word;
+    size_t wlen = strlen(word);
+    long found = 0;
+    size_t pos = start;
+
+    if (!validWord(word, wlen))
+        return 0;
+
+    //every line that starts before end is finished by stop
+    size_t stop = lineStart(data, size, end);
+
+    //let the match kernel skip straight to the next occurrence, then widen it out
+    //to the line around it
+    while (pos < stop){
+        const char *hit = findWord(data + pos, stop - pos, word, wlen);
+        if (!hit)
+            break;
+
+        const char *prev = memrchr(data + pos, '\n', hit - (data + pos));
+        size_t from = prev ? (size_t) (prev - data) + 1 : pos;
+        const char *nl = memchr(hit + wlen, '\n', (data + size) - (hit + wlen));
+        size_t to = nl ? (size_t) (nl - data) : size;
+
+        Slice line = { base + (off_t) from, to - from };
+        onMatch(data + from, line, &wordId, 1, ctx);
+        found++;
+        pos = to + 1;
+    }
+    return found;
+}
+
+/**
+ * Scans a source that isn't mapped by reading it through the window.  Only whole
+ * lines are scanned from each read; the unfinished tail is moved to the front of
+ * the window and completed by the next read.
+ *
+ * @param src     the source to scan
+ * @param query   the word or patterns to search for
+ * @param onMatch function called for each matching line
+ * @param ctx     context pointer passed through to onMatch
+ * @return number of matching lines, or -1 if a read error occurred
+ */
+static long scanWindow(Source *src, const Query *query, MatchFunc onMatch, void *ctx)
+{
+    long found = 0;
+    ssize_t got;
+
+    src->size = 0;
+    src->base = 0;
+
+    while (1){
+        //make room when a single line fills the whole window
+        if (src->size == src->capacity){
+            char *grown = (char *) realloc(src->data, src->capacity * STD_INCRMT);
+            if (!grown)
+                return -1;
+            src->data = grown;
+            src->capacity *= STD_INCRMT;
+        }
+
+        got = read(src->fd, src->data + src->size, src->capacity - src->size);
+        if (got < 0){
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (got == 0)
+            break;
+
+        //scan only up to the last complete line in the window
+        size_t scanned = src->size;
+        src->size += (size_t) got;
+        const char *last = memrchr(src->data + scanned, '\n', src->size - scanned);
+        if (!last)
+            continue;
+
+        size_t done = (size_t) (last - src->data) + 1;
+        found += scanLines(src->data, done, 0, done, src->base, query, onMatch, ctx);
+
+        memmove(src->data, src->data + done, src->size - done);
+        src->size -= done;
+        src->base += (off_t) done;
+    }
+
+    //the last line of the stream may not end with a newline
+    if (src->size > 0)
+        found += scanLines(src->data, src->size, 0, src->size, src->base, query, onMatch, ctx);
+    return found;
+}
+
+long scanSource(Source *src, const Query *query, MatchFunc onMatch, void *ctx)
+{
+    if (!src->mapped)
+        return scanWindow(src, query, onMatch, ctx);
+    return scanLines(src->data, src->size, 0, src->size, 0, query, onMatch, ctx);
+}
@@ -0,0 +1,141 @@
+/**
+ * @author David Hines (dhhines)
+ * @file scan.h
+ *
+ * Zero-copy scanning engine shared by the find and find2 programs.  Regular files
+ * are memory mapped and walked in place; pipes, terminals and stdin fall back to a
+ * buffered read() window.  Either way the text is never copied into per-line
+ * buffers and matching lines are reported as (offset, length) slices of the source.
+ *
+ * Word matching uses the same whole-word semantics as the original
+ * sscanf("%s") tokenization: a word is a maximal run of non-whitespace
+ * characters and lines are separated by '\n'.  A search is either for a single
+ * word or for a list of patterns compiled into an Aho-Corasick automaton (see
+ * aho.h), which finds every pattern in one pass.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//name used on the command line to search standard input
+#define STDIN_NAME "-"
+
+//a line of text that matched, described as a slice of the scanned source
+typedef struct Slice_struct {
+    off_t offset;   //byte offset of the first character of the line in the source
+    size_t length;  //number of characters in the line (not including the newline)
+} Slice;
+
+//source of text to search, either a read only mapping of a regular file or a
+//buffered read() window over a pipe, terminal or stdin
+typedef struct Source_struct {
+    const char *name;  //name of the file (STDIN_NAME for standard input)
+    int fd;  //open file descriptor, -1 once the file is mapped
+    int mapped;  //1 when data holds a mapping of the whole file
+    char *data;  //mapped file contents or the read() window
+    size_t size;  //bytes in the mapping or bytes currently held in the window
+    size_t capacity;  //capacity of the read() window (0 when mapped)
+    off_t base;  //stream offset of data[0] (always 0 when mapped)
+} Source;
+
+typedef struct Automaton_Struct Automaton;
+
+//what to search for: a single word, or a list of patterns compiled into an automaton
+typedef struct Query_struct {
+    const char *word;  //the search word (NULL when searching for patterns)
+    Automaton *ac;  //the pattern automaton (NULL when searching for a word)
+} Query;
+
+/**
+ * Function called for every line that contains the search word (or patterns).
+ *
+ * @param text   pointer to the first character of the line (not NUL terminated and
+ *  only valid for the duration of the call when reading from a pipe)
+ * @param line   offset and length of the line within the source
+ * @param ids    ids of the words found on the line (see queryWord); always the
+ *  single id 0 when searching for one word
+ * @param numIds number of ids
+ * @param ctx    caller supplied context pointer
+ */
+typedef void (*MatchFunc)(const char *text, Slice line, const int *ids, int numIds, void *ctx);
+
+/**
+ * Opens the named file for scanning.  Regular files are mapped read only, anything
+ * else is set up for buffered reads.
+ *
+ * @param src  the source to initialize
+ * @param name file name to open, or STDIN_NAME for standard input
+ * @return 0 on success, -1 (with errno set) if the file can't be opened or mapped
+ */
+int openSource(Source *src, const char *name);
+
+/**
+ * Releases the mapping or read window and closes the file.
+ *
+ * @param src the source to close
+ */
+void closeSource(Source *src);
+
+/**
+ * Returns true for the characters that separate words (the isspace() set in the
+ * C locale, matching the delimiters used by the "%s" conversion).
+ *
+ * @param ch the character to test
+ * @return 1 if ch is a word delimiter, 0 otherwise
+ */
+int isDelim(char ch);
+
+/**
+ * Finds the first line that starts at or after pos.  Used to align the byte ranges
+ * a large file is split into so every line is scanned by exactly one range.
+ *
+ * @param data buffer holding the text
+ * @param size number of bytes in data
+ * @param pos  nominal start of the range
+ * @return offset of the first line starting at or after pos (size if none does)
+ */
+size_t lineStart(const char *data, size_t size, size_t pos);
+
+/**
+ * Returns the text of a word reported to a MatchFunc.
+ *
+ * @param query the search
+ * @param id    the id of the word
+ * @return the word
+ */
+const char *queryWord(const Query *query, int id);
+
+/**
+ * Scans the lines that start within [start, end) of the buffer for the query.  A
+ * line may run past end but never past size.  start must be the first character
+ * of a line.
+ *
+ * @param data    the buffer to scan
+ * @param size    total number of bytes available in data
+ * @param start   offset of the first line to scan
+ * @param end     lines starting at or after this offset are not scanned
+ * @param base    stream offset of data[0], added to the reported slices
+ * @param query   the word or patterns to search for
+ * @param onMatch function called for each matching line
+ * @param ctx     context pointer passed through to onMatch
+ * @return number of matching lines
+ */
+long scanLines(const char *data, size_t size, size_t start, size_t end, off_t base,
+               const Query *query, MatchFunc onMatch, void *ctx);
+
+/**
+ * Scans the entire source for the query, reading it through the window when the
+ * source is not mapped.
+ *
+ * @param src     the source to scan
+ * @param query   the word or patterns to search for
+ * @param onMatch function called for each matching line
+ * @param ctx     context pointer passed through to onMatch
+ * @return number of matching lines, or -1 if a read error occurred
+ */
+long scanSource(Source *src, const Query *query, MatchFunc onMatch, void *ctx);
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * @author David Hines (dhhines)
+ * @file bytelife.c
+ *
+ * Implementation of the byte per cell engine (see bytelife.h).
+ *
+ * The grid has a ghost row above and below and ghost columns on both sides that stay 0, and
+ * rows are padded to a multiple of 64 bytes.  Cells are 0 or 1, so the sum of a 3 x 3 block
+ * (cell included) fits in a byte: a cell is alive in the next generation if the sum is 3, or
+ * if it is alive and the sum is 4, which is the same rule as in lifelib.c.  Every kernel uses
+ * this rule.
+ *
+ * The sum is separable: each row is first summed horizontally (left + cell + right) into one
+ * of three rows of partial sums, and a cell's 3 x 3 sum is then the vertical add of the
+ * partial sums above, at and below it.  A step sums each row once and reuses it for the three
+ * output rows it touches, so a vector of cells costs three unaligned loads and two adds for
+ * the horizontal sum and two adds for the vertical one, instead of nine loads and eight adds.
+ * The vector kernels only write the cells inside the grid; the last few cells of a row that
+ * do not fill a vector are left to the scalar kernels.
+ */
+
+#include "bytelife.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+//rows are padded to a multiple of this many bytes
+#define ROW_ALIGN 64
+
+/**
+ * Function computing the horizontal sums (left + cell + right) of cells [first, last] of a
+ * row.
+ *
+ * @param row   the row
+ * @param sums  where to store the sums, by column
+ * @param first first column (index in the row, ghost column included)
+ * @param last  last column
+ */
+typedef void (*SumKernel)(const uint8_t *row, uint8_t *sums, int first, int last);
+
+/**
+ * Function computing the next generation of cells [first, last] of a row from the horizontal
+ * sums of the row and the rows above and below it.
+ *
+ * @param above sums of the row above
+ * @param sums  sums of the row
+ * @param below sums of the row below
+ * @param row   the row
+ * @param out   the row of the next generation
+ * @param first first column (index in the row, ghost column included)
+ * @param last  last column
+ */
+typedef void (*RowKernel)(const uint8_t *above, const uint8_t *sums, const uint8_t *below,
+                          const uint8_t *row, uint8_t *out, int first, int last);
+
+struct ByteLife_Struct {
+    int rows;  //number of rows in grid
+    int cols;  //number of columns in grid
+    int stride;  //bytes in a row including the ghost columns and padding
+    uint8_t *currGrid;  //(rows + 2) x stride cells of the current generation
+    uint8_t *nextGenGrid;  //(rows + 2) x stride cells the next generation is written to
+    uint8_t *sums;  //3 x stride horizontal sums, row y in row y % 3
+    SumKernel sumKernel;  //the kernels picked for the processor
+    RowKernel kernel;
+    const char *kernelName;
+};
+
+/**
+ * Plain C sum kernel.
+ */
+static void scalarSums(const uint8_t *row, uint8_t *sums, int first, int last)
+{
+    for (int x = first; x <= last; x++)
+        sums[x] = row[x - 1] + row[x] + row[x + 1];
+}
+
+/**
+ * Plain C row kernel: adds the sums of the three rows and applies the rules.
+ */
+static void scalarRow(const uint8_t *above, const uint8_t *sums, const uint8_t *below,
+                      const uint8_t *row, uint8_t *out, int first, int last)
+{
+    for (int x = first; x <= last; x++){
+        int sum = above[x] + sums[x] + below[x];
+
+        //sum (cell included) of 3, or 4 with the cell alive
+        out[x] = (sum == 3) | ((sum == 4) & row[x]);
+    }
+}
+
+/**
+ * AVX2 sum kernel: 32 cells at a time.
+ */
+__attribute__((target("avx2")))
+static void avx2Sums(const uint8_t *row, uint8_t *sums, int first, int last)
+{
+    int x = first;
+
+    for (; x + 31 <= last; x += 32){
+        __m256i sum = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *) (row + x - 1)),
+                      _mm256_add_epi8(_mm256_loadu_si256((const __m256i *) (row + x)),
+                                      _mm256_loadu_si256((const __m256i *) (row + x + 1))));
+        _mm256_storeu_si256((__m256i *) (sums + x), sum);
+    }
+    scalarSums(row, sums, x, last);
+}
+
+/**
+ * AVX2 row kernel: 32 cells at a time.
+ */
+__attribute__((target("avx2")))
+static void avx2Row(const uint8_t *above, const uint8_t *sums, const uint8_t *below,
+                    const uint8_t *row, uint8_t *out, int first, int last)
+{
+    const __m256i three = _mm256_set1_epi8(3);
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i one = _mm256_set1_epi8(1);
+    int x = first;
+
+    for (; x + 31 <= last; x += 32){
+        __m256i center = _mm256_loadu_si256((const __m256i *) (row + x));
+        __m256i sum = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *) (above + x)),
+                      _mm256_add_epi8(_mm256_loadu_si256((const __m256i *) (sums + x)),
+                                      _mm256_loadu_si256((const __m256i *) (below + x))));
+
+        //sum (cell included) of 3, or 4 with the cell alive
+        __m256i born = _mm256_and_si256(_mm256_cmpeq_epi8(sum, three), one);
+        __m256i stays = _mm256_and_si256(_mm256_cmpeq_epi8(sum, four), center);
+        _mm256_storeu_si256((__m256i *) (out + x), _mm256_or_si256(born, stays));
+    }
+    scalarRow(above, sums, below, row, out, x, last);
+}
+
+/**
+ * AVX-512 sum kernel: 64 cells at a time.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void avx512Sums(const uint8_t *row, uint8_t *sums, int first, int last)
+{
+    int x = first;
+
+    for (; x + 63 <= last; x += 64){
+        __m512i sum = _mm512_add_epi8(_mm512_loadu_si512(row + x - 1),
+                      _mm512_add_epi8(_mm512_loadu_si512(row + x), _mm512_loadu_si512(row + x + 1)));
+        _mm512_storeu_si512(sums + x, sum);
+    }
+    scalarSums(row, sums, x, last);
+}
+
+/**
+ * AVX-512 row kernel: 64 cells at a time.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void avx512Row(const uint8_t *above, const uint8_t *sums, const uint8_t *below,
+                      const uint8_t *row, uint8_t *out, int first, int last)
+{
+    const __m512i three = _mm512_set1_epi8(3);
+    const __m512i four = _mm512_set1_epi8(4);
+    int x = first;
+
+    for (; x + 63 <= last; x += 64){
+        __m512i center = _mm512_loadu_si512(row + x);
+        __m512i sum = _mm512_add_epi8(_mm512_loadu_si512(above + x),
+                      _mm512_add_epi8(_mm512_loadu_si512(sums + x), _mm512_loadu_si512(below + x)));
+
+        //sum (cell included) of 3, or 4 with the cell alive
+        __mmask64 alive = _mm512_cmpeq_epi8_mask(sum, three)
+                        | (_mm512_cmpeq_epi8_mask(sum, four) & _mm512_test_epi8_mask(center, center));
+        _mm512_storeu_si512(out + x, _mm512_maskz_set1_epi8(alive, 1));
+    }
+    scalarRow(above, sums, below, row, out, x, last);
+}
+
+/**
+ * Picks the kernels: the ones asked for with LIFE_KERNEL if supported, otherwise the
+ * widest ones supported.
+ *
+ * @param bl the grid
+ */
+static void pickKernel(ByteLife *bl)
+{
+    const char *want = getenv("LIFE_KERNEL");
+    int avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    int avx2 = __builtin_cpu_supports("avx2");
+
+    if (want && strcmp(want, "scalar") == 0)
+        avx512 = avx2 = 0;
+    else if (want && strcmp(want, "avx2") == 0)
+        avx512 = 0;
+
+    if (avx512){
+        bl->sumKernel = avx512Sums;
+        bl->kernel = avx512Row;
+        bl->kernelName = "avx512";
+    }
+    else if (avx2){
+        bl->sumKernel = avx2Sums;
+        bl->kernel = avx2Row;
+        bl->kernelName = "avx2";
+    }
+    else {
+        bl->sumKernel = scalarSums;
+        bl->kernel = scalarRow;
+        bl->kernelName = "scalar";
+    }
+}
+
+ByteLife *createByteLife(int rows, int cols)
+{
+    ByteLife *bl = (ByteLife *) calloc(1, sizeof(ByteLife));
+    if (!bl)
+        exit(EXIT_FAILURE);
+
+    bl->rows = rows;
+    bl->cols = cols;
+    bl->stride = (cols + 2 + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+
+    size_t bytes = (size_t) (rows + 2) * bl->stride;
+    bl->currGrid = (uint8_t *) aligned_alloc(ROW_ALIGN, bytes);
+    bl->nextGenGrid = (uint8_t *) aligned_alloc(ROW_ALIGN, bytes);
+    bl->sums = (uint8_t *) aligned_alloc(ROW_ALIGN, (size_t) 3 * bl->stride);
+    if (!bl->currGrid || !bl->nextGenGrid || !bl->sums)
+        exit(EXIT_FAILURE);
+    memset(bl->currGrid, 0, bytes);
+    memset(bl->nextGenGrid, 0, bytes);
+
+    pickKernel(bl);
+    return bl;
+}
+
+void freeByteLife(ByteLife *bl)
+{
+    free(bl->currGrid);
+    free(bl->nextGenGrid);
+    free(bl->sums);
+    free(bl);
+}
+
+const char *byteKernel(const ByteLife *bl)
+{
+    return bl->kernelName;
+}
+
+int byteGet(const ByteLife *bl, int y, int x)
+{
+    return bl->currGrid[(size_t) (y + 1) * bl->stride + x + 1];
+}
+
+void byteSet(ByteLife *bl, int y, int x, int value)
+{
+    bl->currGrid[(size_t) (y + 1) * bl->stride + x + 1] = value != 0;
+}
+
+void byteStep(ByteLife *bl)
+{
+    //only cells inside the grid are written, so the ghosts of both buffers stay 0; the ghost
+    //rows are summed like the others (to 0)
+    size_t stride = bl->stride;
+    bl->sumKernel(bl->currGrid, bl->sums, 1, bl->cols);
+    bl->sumKernel(bl->currGrid + stride, bl->sums + stride, 1, bl->cols);
+    for (int y = 1; y <= bl->rows; y++){
+        uint8_t *row = bl->currGrid + (size_t) y * stride;
+        uint8_t *above = bl->sums + (size_t) ((y - 1) % 3) * stride;
+        uint8_t *sums = bl->sums + (size_t) (y % 3) * stride;
+        uint8_t *below = bl->sums + (size_t) ((y + 1) % 3) * stride;
+
+        //the row below is summed once here and reused by this row and the next two
+        bl->sumKernel(row + stride, below, 1, bl->cols);
+        bl->kernel(above, sums, below, row, bl->nextGenGrid + (size_t) y * stride, 1, bl->cols);
+    }
+
+    uint8_t *tmp = bl->currGrid;
+    bl->currGrid = bl->nextGenGrid;
+    bl->nextGenGrid = tmp;
+}
@@ -0,0 +1,71 @@
+/**
+ * @author David Hines (dhhines)
+ * @file bytelife.h
+ *
+ * Byte per cell engine for the life library (see life.h, life_create_bytes).  Every cell is
+ * one uint8_t, so the engine can later hold more than two states per cell.  The 3 x 3 sums of
+ * a whole row are computed with AVX-512 or AVX2 adds of 64 or 32 cells at a time, picked at
+ * run time from what the processor supports, with a plain C loop as the fallback.
+ *
+ * The cells outside the grid are always dead, like in the other engines, so all of them give
+ * the same grids.
+ */
+
+#ifndef BYTELIFE_H
+#define BYTELIFE_H
+
+typedef struct ByteLife_Struct ByteLife;
+
+/**
+ * Creates an empty (all dead) byte per cell grid and picks the row kernel: the one named by
+ * the LIFE_KERNEL environment variable ("avx512", "avx2" or "scalar") if the processor
+ * supports it, otherwise the widest one it supports.
+ *
+ * @param rows number of rows in the grid
+ * @param cols number of columns in the grid
+ * @return the new grid
+ */
+ByteLife *createByteLife(int rows, int cols);
+
+/**
+ * Frees a byte per cell grid.
+ *
+ * @param bl the grid
+ */
+void freeByteLife(ByteLife *bl);
+
+/**
+ * Returns the name of the row kernel the grid uses ("avx512", "avx2" or "scalar").
+ *
+ * @param bl the grid
+ */
+const char *byteKernel(const ByteLife *bl);
+
+/**
+ * Returns the value of a cell (0 based row and column).
+ *
+ * @param bl the grid
+ * @param y  row of the cell
+ * @param x  column of the cell
+ * @return 1 if the cell is alive, 0 otherwise
+ */
+int byteGet(const ByteLife *bl, int y, int x);
+
+/**
+ * Sets the value of a cell (0 based row and column).
+ *
+ * @param bl    the grid
+ * @param y     row of the cell
+ * @param x     column of the cell
+ * @param value 1 for alive, 0 for dead
+ */
+void byteSet(ByteLife *bl, int y, int x, int value);
+
+/**
+ * Advances the grid by one generation.
+ *
+ * @param bl the grid
+ */
+void byteStep(ByteLife *bl);
+
+#endif
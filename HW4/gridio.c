@@ -0,0 +1,394 @@
+/**
+ * @author David Hines (dhhines)
+ * @file gridio.c
+ *
+ * Implementation of the grid readers and writers (see gridio.h).
+ */
+
+#include "gridio.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//first bytes of a binary grid file
+#define BIN_MAGIC "LIFEGRID"
+#define BIN_MAGIC_LEN 8
+//size of the binary header: magic, rows and columns
+#define BIN_HEADER (BIN_MAGIC_LEN + 8)
+//longest line written in an RLE file
+#define RLE_LINE 70
+
+//formats of grid files
+typedef enum { TEXT, RLE, BINARY } Format;
+
+struct GridFile_Struct {
+    const char *data;  //the mapped file
+    size_t size;  //bytes in the file
+    Format format;
+    size_t body;  //offset of the cells after the header
+    int rows;
+    int cols;
+};
+
+/**
+ * Skips white space.
+ *
+ * @param gf  the file
+ * @param pos offset to start at
+ * @return offset of the next other character, or size
+ */
+static size_t skipSpace(const GridFile *gf, size_t pos)
+{
+    while (pos < gf->size && isspace((unsigned char) gf->data[pos]))
+        pos++;
+    return pos;
+}
+
+/**
+ * Reads an integer like fscanf("%d"): optional white space, optional sign, digits.
+ *
+ * @param gf    the file
+ * @param pos   offset to start at, moved past the integer
+ * @param value where to store the integer
+ * @return 1 if an integer was read, 0 otherwise
+ */
+static int readInt(const GridFile *gf, size_t *pos, long *value)
+{
+    size_t p = skipSpace(gf, *pos);
+    int negative = 0;
+
+    if (p < gf->size && (gf->data[p] == '-' || gf->data[p] == '+'))
+        negative = gf->data[p++] == '-';
+    if (p >= gf->size || !isdigit((unsigned char) gf->data[p]))
+        return 0;
+
+    long n = 0;
+    while (p < gf->size && isdigit((unsigned char) gf->data[p])){
+        if (n < 1000000000L)
+            n = n * 10 + (gf->data[p] - '0');
+        p++;
+    }
+    *value = negative ? -n : n;
+    *pos = p;
+    return 1;
+}
+
+/**
+ * Reads the "x = cols, y = rows" header of an RLE file, after any # comment lines.
+ *
+ * @param gf the file
+ * @return 1 if the header is valid, 0 otherwise
+ */
+static int readRLEHeader(GridFile *gf)
+{
+    size_t pos = skipSpace(gf, 0);
+    while (pos < gf->size && gf->data[pos] == '#'){
+        while (pos < gf->size && gf->data[pos] != '\n')
+            pos++;
+        pos = skipSpace(gf, pos);
+    }
+
+    //the header is one line, copied so sscanf stops at its end
+    char line[256];
+    size_t len = 0;
+    while (pos < gf->size && gf->data[pos] != '\n' && len < sizeof(line) - 1)
+        line[len++] = gf->data[pos++];
+    line[len] = '\0';
+    while (pos < gf->size && gf->data[pos] != '\n')
+        pos++;
+
+    if (sscanf(line, " x = %d , y = %d", &gf->cols, &gf->rows) != 2)
+        return 0;
+    gf->body = pos;
+    return 1;
+}
+
+GridFile *openGrid(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0){
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    GridFile *gf = (GridFile *) calloc(1, sizeof(GridFile));
+    if (!gf)
+        exit(EXIT_FAILURE);
+    gf->data = (const char *) data;
+    gf->size = st.st_size;
+
+    //tell the format apart by the first bytes
+    size_t start = skipSpace(gf, 0);
+    int valid;
+    if (gf->size >= BIN_HEADER && memcmp(gf->data, BIN_MAGIC, BIN_MAGIC_LEN) == 0){
+        const unsigned char *h = (const unsigned char *) gf->data + BIN_MAGIC_LEN;
+        uint32_t rows = h[0] | h[1] << 8 | h[2] << 16 | (uint32_t) h[3] << 24;
+        uint32_t cols = h[4] | h[5] << 8 | h[6] << 16 | (uint32_t) h[7] << 24;
+        gf->format = BINARY;
+        gf->rows = rows > 0x7fffffff ? -1 : (int) rows;
+        gf->cols = cols > 0x7fffffff ? -1 : (int) cols;
+        gf->body = BIN_HEADER;
+        valid = gf->rows > 0 && gf->cols > 0
+             && gf->size - BIN_HEADER >= (size_t) gf->rows * ((gf->cols + 7) / 8);
+    }
+    else if (start < gf->size && (gf->data[start] == '#' || gf->data[start] == 'x')){
+        gf->format = RLE;
+        valid = readRLEHeader(gf);
+    }
+    else {
+        long rows = 0, cols = 0;
+        gf->format = TEXT;
+        gf->body = 0;
+        valid = readInt(gf, &gf->body, &rows) && readInt(gf, &gf->body, &cols)
+             && rows > 0 && cols > 0 && rows < 1000000000L && cols < 1000000000L;
+        gf->rows = (int) rows;
+        gf->cols = (int) cols;
+    }
+
+    if (!valid || gf->rows < 1 || gf->cols < 1){
+        closeGrid(gf);
+        return NULL;
+    }
+    return gf;
+}
+
+int gridRows(const GridFile *gf)
+{
+    return gf->rows;
+}
+
+int gridCols(const GridFile *gf)
+{
+    return gf->cols;
+}
+
+/**
+ * Sets the live cells of an RLE body.  Cells past the size in the header are ignored.
+ *
+ * @param gf   the file
+ * @param life the simulation
+ */
+static void loadRLE(const GridFile *gf, Life *life)
+{
+    int y = 0, x = 0;
+    long count = 0;
+
+    for (size_t pos = gf->body; pos < gf->size; pos++){
+        char c = gf->data[pos];
+
+        if (isdigit((unsigned char) c)){
+            if (count < 1000000000L)
+                count = count * 10 + (c - '0');
+            continue;
+        }
+        long run = count ? count : 1;
+        count = 0;
+
+        if (c == '!')
+            break;
+        else if (c == '$'){
+            y += run;
+            x = 0;
+        }
+        else if (c == 'b' || c == '.')
+            x += run;
+        else if (isalpha((unsigned char) c)){
+            //o, or a state letter of a multi-state pattern
+            for (long i = 0; i < run; i++, x++)
+                if (y < gf->rows && x < gf->cols)
+                    life_set(life, y, x, 1);
+        }
+        else if (c == '#'){
+            while (pos < gf->size && gf->data[pos] != '\n')
+                pos++;
+        }
+        if (y >= gf->rows)
+            break;
+    }
+}
+
+void loadGrid(const GridFile *gf, Life *life)
+{
+    if (gf->format == RLE){
+        loadRLE(gf, life);
+        return;
+    }
+
+    if (gf->format == BINARY){
+        const unsigned char *bits = (const unsigned char *) gf->data + gf->body;
+        size_t rowBytes = (gf->cols + 7) / 8;
+        for (int i = 0; i < gf->rows; i++, bits += rowBytes)
+            for (size_t k = 0; k < rowBytes; k++)
+                for (int b = 0; bits[k] >> b; b++)
+                    if ((bits[k] >> b) & 1 && k * 8 + b < (size_t) gf->cols)
+                        life_set(life, i, (int) (k * 8 + b), 1);
+        return;
+    }
+
+    //text values are single digits nearly always, so those are read without readInt
+    size_t pos = gf->body;
+    for (int i = 0; i < gf->rows; i++)
+        for (int j = 0; j < gf->cols; j++){
+            long value;
+            pos = skipSpace(gf, pos);
+            if (pos + 1 < gf->size && isdigit((unsigned char) gf->data[pos])
+                && !isdigit((unsigned char) gf->data[pos + 1]))
+                value = gf->data[pos++] - '0';
+            else if (!readInt(gf, &pos, &value))
+                return;
+            if (value == 1)
+                life_set(life, i, j, 1);
+        }
+}
+
+void closeGrid(GridFile *gf)
+{
+    munmap((void *) gf->data, gf->size);
+    free(gf);
+}
+
+void writeText(FILE *fp, const Life *life)
+{
+    int rows = life_rows(life);
+    int cols = life_cols(life);
+    unsigned char *cells = (unsigned char *) malloc(cols);
+    char *line = (char *) malloc(2 * (size_t) cols + 1);
+    if (!cells || !line)
+        exit(EXIT_FAILURE);
+
+    for (int i = 0; i < rows; i++){
+        life_row(life, i, cells);
+        for (int j = 0; j < cols; j++){
+            line[2 * j] = '0' + cells[j];
+            line[2 * j + 1] = ' ';
+        }
+        line[2 * (size_t) cols] = '\n';
+        fwrite(line, 1, 2 * (size_t) cols + 1, fp);
+    }
+    fputc('\n', fp);
+    free(cells);
+    free(line);
+}
+
+/**
+ * Adds one run to an RLE body, starting a new line when the current one would get too long.
+ *
+ * @param fp    where to write
+ * @param run   length of the run
+ * @param tag   b, o or $
+ * @param width characters on the current line so far, updated
+ */
+static void putRun(FILE *fp, long run, char tag, int *width)
+{
+    char item[24];
+    int len = run > 1 ? snprintf(item, sizeof(item), "%ld%c", run, tag)
+                      : snprintf(item, sizeof(item), "%c", tag);
+
+    if (*width + len > RLE_LINE){
+        fputc('\n', fp);
+        *width = 0;
+    }
+    fputs(item, fp);
+    *width += len;
+}
+
+void writeRLE(FILE *fp, const Life *life)
+{
+    int rows = life_rows(life);
+    int cols = life_cols(life);
+    unsigned char *cells = (unsigned char *) malloc(cols);
+    if (!cells)
+        exit(EXIT_FAILURE);
+
+    fprintf(fp, "x = %d, y = %d, rule = B3/S23\n", cols, rows);
+    int width = 0;
+    long newlines = 0;
+    for (int i = 0; i < rows; i++){
+        life_row(life, i, cells);
+
+        //trailing dead cells of a row and empty rows are left out
+        int end = cols;
+        while (end > 0 && !cells[end - 1])
+            end--;
+        if (end == 0){
+            newlines++;
+            continue;
+        }
+        if (newlines)
+            putRun(fp, newlines, '$', &width);
+
+        for (int j = 0; j < end;){
+            int k = j;
+            while (k < end && cells[k] == cells[j])
+                k++;
+            putRun(fp, k - j, cells[j] ? 'o' : 'b', &width);
+            j = k;
+        }
+        newlines = 1;
+    }
+    fputs("!\n", fp);
+    free(cells);
+}
+
+void writeBinary(FILE *fp, const Life *life)
+{
+    int rows = life_rows(life);
+    int cols = life_cols(life);
+    size_t rowBytes = (cols + 7) / 8;
+    unsigned char header[BIN_HEADER];
+    unsigned char *cells = (unsigned char *) malloc(cols);
+    unsigned char *bits = (unsigned char *) malloc(rowBytes);
+    if (!cells || !bits)
+        exit(EXIT_FAILURE);
+
+    memcpy(header, BIN_MAGIC, BIN_MAGIC_LEN);
+    for (int b = 0; b < 4; b++){
+        header[BIN_MAGIC_LEN + b] = (unsigned char) (rows >> (8 * b));
+        header[BIN_MAGIC_LEN + 4 + b] = (unsigned char) (cols >> (8 * b));
+    }
+    fwrite(header, 1, BIN_HEADER, fp);
+
+    for (int i = 0; i < rows; i++){
+        life_row(life, i, cells);
+        memset(bits, 0, rowBytes);
+        for (int j = 0; j < cols; j++)
+            bits[j / 8] |= cells[j] << (j % 8);
+        fwrite(bits, 1, rowBytes, fp);
+    }
+    free(cells);
+    free(bits);
+}
+
+unsigned long long gridChecksum(const Life *life)
+{
+    int rows = life_rows(life);
+    int cols = life_cols(life);
+    unsigned char *cells = (unsigned char *) malloc(cols);
+    if (!cells)
+        exit(EXIT_FAILURE);
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < rows; i++){
+        life_row(life, i, cells);
+        for (int j = 0; j < cols; j++){
+            hash ^= cells[j];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    free(cells);
+    return hash;
+}
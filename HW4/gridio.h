@@ -0,0 +1,90 @@
+/**
+ * @author David Hines (dhhines)
+ * @file gridio.h
+ *
+ * Reading and writing life grids.  Three formats are read, told apart by their first bytes:
+ *  - text: the number of rows and columns followed by a 0 or 1 for every cell, as in the
+ *    provided boards (any value other than 1 is a dead cell)
+ *  - RLE: the standard run length encoded pattern format ("x = cols, y = rows" header, # lines
+ *    for comments, b for dead, o or any other letter for alive, $ for end of row, ! to end)
+ *  - binary: the 8 bytes "LIFEGRID", the rows and columns as 4 byte little endian numbers,
+ *    then every row as (cols + 7) / 8 bytes with column c in bit c % 8 of byte c / 8
+ *
+ * Files are mapped into memory and parsed in place.  The writers go through one row buffer
+ * per grid row instead of a call per cell.
+ */
+
+#ifndef GRIDIO_H
+#define GRIDIO_H
+
+#include "life.h"
+#include <stdio.h>
+
+typedef struct GridFile_Struct GridFile;
+
+/**
+ * Maps a grid file and reads its size.
+ *
+ * @param path name of the file
+ * @return the open file, or NULL if it can't be read or its size is invalid
+ */
+GridFile *openGrid(const char *path);
+
+/**
+ * Returns the number of rows of the grid in the file.
+ */
+int gridRows(const GridFile *gf);
+
+/**
+ * Returns the number of columns of the grid in the file.
+ */
+int gridCols(const GridFile *gf);
+
+/**
+ * Sets the live cells of the file in an all dead simulation of the same size.
+ *
+ * @param gf   the open file
+ * @param life the simulation
+ */
+void loadGrid(const GridFile *gf, Life *life);
+
+/**
+ * Unmaps and frees a grid file.
+ *
+ * @param gf the open file
+ */
+void closeGrid(GridFile *gf);
+
+/**
+ * Writes the grid as text: a 0 or 1 and a space for every cell, one row per line, and a
+ * blank line after the grid.
+ *
+ * @param fp   where to write
+ * @param life the simulation
+ */
+void writeText(FILE *fp, const Life *life);
+
+/**
+ * Writes the grid as an RLE pattern.
+ *
+ * @param fp   where to write
+ * @param life the simulation
+ */
+void writeRLE(FILE *fp, const Life *life);
+
+/**
+ * Writes the grid in the binary format.
+ *
+ * @param fp   where to write
+ * @param life the simulation
+ */
+void writeBinary(FILE *fp, const Life *life);
+
+/**
+ * Returns a checksum of the grid (64 bit FNV-1a of the cells, row by row, one byte each).
+ *
+ * @param life the simulation
+ */
+unsigned long long gridChecksum(const Life *life);
+
+#endif
@@ -0,0 +1,665 @@
+/**
+ * @author David Hines (dhhines)
+ * @file hashlife.c
+ *
+ * Implementation of the HashLife engine (see hashlife.h).
+ *
+ * A node of level L is a square of 2^L cells made of four nodes of level L - 1; level 0 is a
+ * single cell.  Nodes are hash-consed through one hash table, so a square is only ever stored
+ * once and nodes can be compared by pointer.  The result of a node of level L is its center
+ * square (level L - 1) advanced 2^min(stepLog, L - 2) generations.  It is found from nine
+ * overlapping squares of level L - 1: at full speed (L - 2 <= stepLog) they are advanced
+ * 2^(L - 3) generations, put together into four squares and advanced again; otherwise only
+ * their centers are taken and the four squares are advanced by 2^stepLog.  A jump of 2^k
+ * generations sets stepLog to k and takes the result of the root.
+ *
+ * The root always has the grid inside its center square; after a jump the result (which is
+ * that center square) is padded with dead cells back to a root of the same size and place.
+ * A square crossing the edge of the grid is advanced the same way but its cells outside the
+ * grid are killed after every generation (in the 4 x 4 base case), so its result depends on
+ * its position; those results are kept in a separate table keyed by node and position.
+ *
+ * Every node the jump in progress still needs is pushed on a stack, so garbage can be
+ * collected in the middle of a jump: the results are dropped, the nodes reachable from the
+ * root, the stack and the empty nodes are marked and the rest go on a free list.  If the
+ * live nodes alone take more than half of the cap the cap is raised, since collecting again
+ * would free almost nothing.
+ */
+
+#include "hashlife.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+//deepest level of the tree, so positions fit in a long long
+#define MAX_LEVEL 62
+//largest single jump is 2^MAX_JUMP generations
+#define MAX_JUMP (MAX_LEVEL - 2)
+//nodes allocated at a time
+#define NODE_BLOCK 4096
+//initial capacity of the hash table, the stack and the edge table (powers of two)
+#define INIT_CPCTY 1024
+
+typedef struct Node_Struct Node;
+
+struct Node_Struct {
+    Node *nw, *ne, *sw, *se;  //quadrants, NULL for a single cell
+    Node *next;  //next node in the same hash bucket, or in the free list
+    Node *result;  //center advanced (see above), NULL if not known yet
+    int level;  //the node is a square of 2^level cells on a side
+    int alive;  //1 if any cell of the square is alive
+    int mark;  //set while collecting garbage
+};
+
+//result of a node crossing the edge of the grid, kept by position
+typedef struct Edge_Struct {
+    Node *node;  //NULL for an empty slot
+    long long x, y;  //position of the node's top left cell
+    Node *result;
+}Edge;
+
+struct HashLife_Struct {
+    int rows;  //number of rows in grid
+    int cols;  //number of columns in grid
+    Node cells[2];  //the dead and the alive single cell
+    Node *empty[MAX_LEVEL + 1];  //the all dead node of each level, NULL until needed
+    Node **buckets;  //hash table of all nodes above level 0
+    size_t numBuckets;
+    size_t numNodes;
+    size_t maxNodes;  //nodes kept before collecting garbage
+    Node *freeList;
+    Node **blocks;  //blocks of NODE_BLOCK nodes
+    int numBlocks;
+    int blockCap;
+    int blockUsed;  //nodes handed out from the last block
+    Node *root;
+    long long ox, oy;  //position of the root's top left cell
+    int stepLog;  //results are for jumps of 2^stepLog generations (see above)
+    Node **stack;  //nodes in use by the jump in progress
+    int sp;
+    int stackCap;
+    Edge *edges;  //open addressing table of results of nodes crossing the edge
+    size_t edgeCap;
+    size_t edgeLen;
+};
+
+static void collect(HashLife *hl);
+
+/**
+ * Pushes a node on the stack so it survives garbage collection.
+ *
+ * @param hl the grid
+ * @param n  the node
+ * @return the node
+ */
+static Node *push(HashLife *hl, Node *n)
+{
+    if (hl->sp == hl->stackCap){
+        hl->stackCap *= 2;
+        hl->stack = (Node **) realloc(hl->stack, hl->stackCap * sizeof(Node *));
+        if (!hl->stack)
+            exit(EXIT_FAILURE);
+    }
+    hl->stack[hl->sp++] = n;
+    return n;
+}
+
+/**
+ * Returns the hash bucket of a node made of four quadrants.
+ */
+static size_t bucketOf(HashLife *hl, Node *nw, Node *ne, Node *sw, Node *se)
+{
+    uint64_t h = (uint64_t) (uintptr_t) nw * 0x9E3779B97F4A7C15ULL;
+    h += (uint64_t) (uintptr_t) ne * 0xBF58476D1CE4E5B9ULL;
+    h += (uint64_t) (uintptr_t) sw * 0x94D049BB133111EBULL;
+    h += (uint64_t) (uintptr_t) se * 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 29;
+    return (size_t) h & (hl->numBuckets - 1);
+}
+
+/**
+ * Doubles the hash table and moves every node to its new bucket.
+ *
+ * @param hl the grid
+ */
+static void growBuckets(HashLife *hl)
+{
+    Node **old = hl->buckets;
+    size_t oldCount = hl->numBuckets;
+
+    hl->numBuckets *= 2;
+    hl->buckets = (Node **) calloc(hl->numBuckets, sizeof(Node *));
+    if (!hl->buckets)
+        exit(EXIT_FAILURE);
+    for (size_t i = 0; i < oldCount; i++)
+        for (Node *n = old[i], *next; n; n = next){
+            next = n->next;
+            size_t b = bucketOf(hl, n->nw, n->ne, n->sw, n->se);
+            n->next = hl->buckets[b];
+            hl->buckets[b] = n;
+        }
+    free(old);
+}
+
+/**
+ * Takes a node from the free list or the current block.
+ *
+ * @param hl the grid
+ * @return the node
+ */
+static Node *allocNode(HashLife *hl)
+{
+    if (hl->freeList){
+        Node *n = hl->freeList;
+        hl->freeList = n->next;
+        return n;
+    }
+    if (hl->numBlocks == 0 || hl->blockUsed == NODE_BLOCK){
+        if (hl->numBlocks == hl->blockCap){
+            hl->blockCap = hl->blockCap ? hl->blockCap * 2 : INIT_CPCTY;
+            hl->blocks = (Node **) realloc(hl->blocks, hl->blockCap * sizeof(Node *));
+            if (!hl->blocks)
+                exit(EXIT_FAILURE);
+        }
+        hl->blocks[hl->numBlocks] = (Node *) malloc(NODE_BLOCK * sizeof(Node));
+        if (!hl->blocks[hl->numBlocks])
+            exit(EXIT_FAILURE);
+        hl->numBlocks++;
+        hl->blockUsed = 0;
+    }
+    return &hl->blocks[hl->numBlocks - 1][hl->blockUsed++];
+}
+
+/**
+ * Returns the node made of four quadrants, making it if it does not exist yet.  The
+ * quadrants are kept safe if garbage has to be collected first.
+ *
+ * @param hl the grid
+ * @param nw north west quadrant
+ * @param ne north east quadrant
+ * @param sw south west quadrant
+ * @param se south east quadrant
+ * @return the node
+ */
+static Node *join(HashLife *hl, Node *nw, Node *ne, Node *sw, Node *se)
+{
+    size_t b = bucketOf(hl, nw, ne, sw, se);
+    for (Node *n = hl->buckets[b]; n; n = n->next)
+        if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se)
+            return n;
+
+    if (hl->numNodes >= hl->maxNodes){
+        push(hl, nw);
+        push(hl, ne);
+        push(hl, sw);
+        push(hl, se);
+        collect(hl);
+        hl->sp -= 4;
+    }
+    if (hl->numNodes >= hl->numBuckets)
+        growBuckets(hl);
+    b = bucketOf(hl, nw, ne, sw, se);
+
+    Node *n = allocNode(hl);
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->result = NULL;
+    n->level = nw->level + 1;
+    n->alive = nw->alive | ne->alive | sw->alive | se->alive;
+    n->mark = 0;
+    n->next = hl->buckets[b];
+    hl->buckets[b] = n;
+    hl->numNodes++;
+    return n;
+}
+
+/**
+ * Returns the all dead node of a level.
+ */
+static Node *empty(HashLife *hl, int level)
+{
+    if (level == 0)
+        return &hl->cells[0];
+    if (!hl->empty[level]){
+        Node *e = empty(hl, level - 1);
+        hl->empty[level] = join(hl, e, e, e, e);
+    }
+    return hl->empty[level];
+}
+
+/**
+ * Returns the center square of a node (one level down), without advancing it.
+ */
+static Node *center(HashLife *hl, Node *n)
+{
+    return join(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+/**
+ * Forgets every result kept for nodes crossing the edge of the grid.
+ *
+ * @param hl the grid
+ */
+static void clearEdges(HashLife *hl)
+{
+    memset(hl->edges, 0, hl->edgeCap * sizeof(Edge));
+    hl->edgeLen = 0;
+}
+
+/**
+ * Returns the slot of the edge table for a node at a position: the slot holding it, or the
+ * empty slot where it belongs.
+ */
+static Edge *edgeSlot(HashLife *hl, Node *n, long long x, long long y)
+{
+    uint64_t h = (uint64_t) (uintptr_t) n * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t) x * 0xBF58476D1CE4E5B9ULL;
+    h ^= (uint64_t) y * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+
+    size_t i = (size_t) h & (hl->edgeCap - 1);
+    while (hl->edges[i].node && (hl->edges[i].node != n || hl->edges[i].x != x || hl->edges[i].y != y))
+        i = (i + 1) & (hl->edgeCap - 1);
+    return &hl->edges[i];
+}
+
+/**
+ * Keeps the result of a node crossing the edge of the grid.
+ *
+ * @param hl     the grid
+ * @param n      the node
+ * @param x      column of the node's top left cell
+ * @param y      row of the node's top left cell
+ * @param result the node's result
+ */
+static void addEdge(HashLife *hl, Node *n, long long x, long long y, Node *result)
+{
+    //keep the table at most half full
+    if (2 * (hl->edgeLen + 1) > hl->edgeCap){
+        Edge *old = hl->edges;
+        size_t oldCap = hl->edgeCap;
+
+        hl->edgeCap *= 2;
+        hl->edges = (Edge *) calloc(hl->edgeCap, sizeof(Edge));
+        if (!hl->edges)
+            exit(EXIT_FAILURE);
+        for (size_t i = 0; i < oldCap; i++)
+            if (old[i].node)
+                *edgeSlot(hl, old[i].node, old[i].x, old[i].y) = old[i];
+        free(old);
+    }
+
+    Edge *e = edgeSlot(hl, n, x, y);
+    e->node = n;
+    e->x = x;
+    e->y = y;
+    e->result = result;
+    hl->edgeLen++;
+}
+
+/**
+ * Marks a node and everything below it as in use.
+ */
+static void markNode(Node *n)
+{
+    if (n->level == 0 || n->mark)
+        return;
+    n->mark = 1;
+    markNode(n->nw);
+    markNode(n->ne);
+    markNode(n->sw);
+    markNode(n->se);
+}
+
+/**
+ * Collects garbage: drops all results, marks the nodes still in use and puts the rest on
+ * the free list.
+ *
+ * @param hl the grid
+ */
+static void collect(HashLife *hl)
+{
+    //results may point at any node, so they all go
+    for (size_t i = 0; i < hl->numBuckets; i++)
+        for (Node *n = hl->buckets[i]; n; n = n->next)
+            n->result = NULL;
+    clearEdges(hl);
+
+    if (hl->root)
+        markNode(hl->root);
+    for (int i = 0; i < hl->sp; i++)
+        markNode(hl->stack[i]);
+    for (int i = 1; i <= MAX_LEVEL; i++)
+        if (hl->empty[i])
+            markNode(hl->empty[i]);
+
+    for (size_t i = 0; i < hl->numBuckets; i++){
+        Node **link = &hl->buckets[i];
+        while (*link){
+            Node *n = *link;
+            if (n->mark){
+                n->mark = 0;
+                link = &n->next;
+            }
+            else {
+                *link = n->next;
+                n->next = hl->freeList;
+                hl->freeList = n;
+                hl->numNodes--;
+            }
+        }
+    }
+
+    //collecting again soon would free almost nothing
+    if (hl->numNodes >= hl->maxNodes / 2)
+        hl->maxNodes = hl->numNodes * 2;
+}
+
+/**
+ * Calculates the 4 x 4 base case: the center 2 x 2 cells one generation on, with the cells
+ * outside the grid killed.
+ *
+ * @param hl the grid
+ * @param n  node of level 2
+ * @param x  column of the node's top left cell
+ * @param y  row of the node's top left cell
+ * @return the center, one generation on
+ */
+static Node *baseStep(HashLife *hl, Node *n, long long x, long long y)
+{
+    Node *quad[4] = {n->nw, n->ne, n->sw, n->se};
+    Node *out[4];
+    int bits = 0;
+
+    //bit 4 * row + column holds each cell of the square
+    for (int i = 0; i < 4; i++){
+        int r = (i / 2) * 2;
+        int c = (i % 2) * 2;
+        bits |= quad[i]->nw->alive << (4 * r + c);
+        bits |= quad[i]->ne->alive << (4 * r + c + 1);
+        bits |= quad[i]->sw->alive << (4 * (r + 1) + c);
+        bits |= quad[i]->se->alive << (4 * (r + 1) + c + 1);
+    }
+
+    for (int i = 0; i < 4; i++){
+        int r = 1 + i / 2;
+        int c = 1 + i % 2;
+        int count = 0;
+
+        for (int dr = -1; dr <= 1; dr++)
+            for (int dc = -1; dc <= 1; dc++)
+                if (dr || dc)
+                    count += (bits >> (4 * (r + dr) + c + dc)) & 1;
+
+        int alive = count == 3 || (count == 2 && ((bits >> (4 * r + c)) & 1));
+        //the cells outside the grid stay dead
+        if (y + r < 0 || y + r >= hl->rows || x + c < 0 || x + c >= hl->cols)
+            alive = 0;
+        out[i] = &hl->cells[alive];
+    }
+    return join(hl, out[0], out[1], out[2], out[3]);
+}
+
+static Node *advance(HashLife *hl, Node *n, long long x, long long y);
+
+/**
+ * Calculates the result of a node (see above).
+ *
+ * @param hl the grid
+ * @param n  node of level 2 or more, on the stack or reachable from the root
+ * @param x  column of the node's top left cell
+ * @param y  row of the node's top left cell
+ * @return the node's result
+ */
+static Node *compute(HashLife *hl, Node *n, long long x, long long y)
+{
+    if (n->level == 2)
+        return baseStep(hl, n, x, y);
+
+    int base = hl->sp;
+    long long q = 1LL << (n->level - 2);
+    int full = n->level - 2 <= hl->stepLog;
+    Node *sub[3][3];
+    Node *part[3][3];
+    Node *out[2][2];
+
+    //the nine overlapping squares one level down
+    sub[0][0] = n->nw;
+    sub[0][2] = n->ne;
+    sub[2][0] = n->sw;
+    sub[2][2] = n->se;
+    sub[0][1] = push(hl, join(hl, n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw));
+    sub[1][0] = push(hl, join(hl, n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne));
+    sub[1][1] = push(hl, join(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw));
+    sub[1][2] = push(hl, join(hl, n->ne->sw, n->ne->se, n->se->nw, n->se->ne));
+    sub[2][1] = push(hl, join(hl, n->sw->ne, n->se->nw, n->sw->se, n->se->sw));
+
+    //their centers, advanced half the way at full speed
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            if (full)
+                part[i][j] = push(hl, advance(hl, sub[i][j], x + j * q, y + i * q));
+            else
+                part[i][j] = push(hl, center(hl, sub[i][j]));
+
+    //put together into four squares and advanced the rest of the way
+    for (int i = 0; i < 2; i++)
+        for (int j = 0; j < 2; j++){
+            Node *m = push(hl, join(hl, part[i][j], part[i][j + 1], part[i + 1][j], part[i + 1][j + 1]));
+            out[i][j] = push(hl, advance(hl, m, x + j * q + q / 2, y + i * q + q / 2));
+        }
+
+    Node *result = join(hl, out[0][0], out[0][1], out[1][0], out[1][1]);
+    hl->sp = base;
+    return result;
+}
+
+/**
+ * Returns the result of a node, from what is kept if possible.
+ *
+ * @param hl the grid
+ * @param n  node of level 2 or more, on the stack or reachable from the root
+ * @param x  column of the node's top left cell
+ * @param y  row of the node's top left cell
+ * @return the node's result
+ */
+static Node *advance(HashLife *hl, Node *n, long long x, long long y)
+{
+    long long size = 1LL << n->level;
+
+    if (!n->alive)
+        return empty(hl, n->level - 1);
+
+    //a node inside the grid gives the same result anywhere
+    if (x >= 0 && y >= 0 && x + size <= hl->cols && y + size <= hl->rows){
+        if (!n->result){
+            Node *result = compute(hl, n, x, y);
+            n->result = result;
+        }
+        return n->result;
+    }
+
+    Edge *e = edgeSlot(hl, n, x, y);
+    if (e->node)
+        return e->result;
+    Node *result = compute(hl, n, x, y);
+    addEdge(hl, n, x, y, result);
+    return result;
+}
+
+/**
+ * Pads the root with dead cells to one level up, keeping the old root in the center.
+ *
+ * @param hl the grid
+ */
+static void expandRoot(HashLife *hl)
+{
+    Node *r = hl->root;
+    Node *e = empty(hl, r->level - 1);
+    int base = hl->sp;
+
+    Node *nw = push(hl, join(hl, e, e, e, r->nw));
+    Node *ne = push(hl, join(hl, e, e, r->ne, e));
+    Node *sw = push(hl, join(hl, e, r->sw, e, e));
+    Node *se = push(hl, join(hl, r->se, e, e, e));
+    hl->root = join(hl, nw, ne, sw, se);
+    hl->sp = base;
+
+    hl->ox -= 1LL << (r->level - 1);
+    hl->oy -= 1LL << (r->level - 1);
+}
+
+/**
+ * Changes the jump size of the results kept.  Results of nodes at or below level
+ * min(old, new) + 2 are at full speed either way and stay.
+ *
+ * @param hl      the grid
+ * @param stepLog the new jump size (2^stepLog generations)
+ */
+static void setStepLog(HashLife *hl, int stepLog)
+{
+    if (stepLog == hl->stepLog)
+        return;
+
+    int keep = (stepLog < hl->stepLog ? stepLog : hl->stepLog) + 2;
+    for (size_t i = 0; i < hl->numBuckets; i++)
+        for (Node *n = hl->buckets[i]; n; n = n->next)
+            if (n->level > keep)
+                n->result = NULL;
+    clearEdges(hl);
+    hl->stepLog = stepLog;
+}
+
+/**
+ * Advances the grid 2^k generations.
+ *
+ * @param hl the grid
+ * @param k  log of the number of generations (at most MAX_JUMP)
+ */
+static void jump(HashLife *hl, int k)
+{
+    while (hl->root->level < k + 2)
+        expandRoot(hl);
+    setStepLog(hl, k);
+
+    //the result is the root's center, which holds the whole grid
+    Node *result = advance(hl, hl->root, hl->ox, hl->oy);
+    long long quarter = 1LL << (hl->root->level - 2);
+    hl->root = result;
+    hl->ox += quarter;
+    hl->oy += quarter;
+    expandRoot(hl);
+}
+
+HashLife *createHashLife(int rows, int cols, size_t memCap)
+{
+    HashLife *hl = (HashLife *) calloc(1, sizeof(HashLife));
+    if (!hl)
+        exit(EXIT_FAILURE);
+
+    hl->rows = rows;
+    hl->cols = cols;
+    hl->cells[1].alive = 1;
+    hl->numBuckets = INIT_CPCTY;
+    hl->buckets = (Node **) calloc(hl->numBuckets, sizeof(Node *));
+    hl->stackCap = INIT_CPCTY;
+    hl->stack = (Node **) malloc(hl->stackCap * sizeof(Node *));
+    hl->edgeCap = INIT_CPCTY;
+    hl->edges = (Edge *) calloc(hl->edgeCap, sizeof(Edge));
+    if (!hl->buckets || !hl->stack || !hl->edges)
+        exit(EXIT_FAILURE);
+    hl->maxNodes = memCap / sizeof(Node);
+    if (hl->maxNodes < INIT_CPCTY)
+        hl->maxNodes = INIT_CPCTY;
+
+    //the smallest root with the grid inside its center square
+    int level = 3;
+    while ((1LL << (level - 1)) < rows || (1LL << (level - 1)) < cols)
+        level++;
+    hl->root = empty(hl, level);
+    hl->ox = -(1LL << (level - 2));
+    hl->oy = -(1LL << (level - 2));
+    return hl;
+}
+
+void freeHashLife(HashLife *hl)
+{
+    for (int i = 0; i < hl->numBlocks; i++)
+        free(hl->blocks[i]);
+    free(hl->blocks);
+    free(hl->buckets);
+    free(hl->stack);
+    free(hl->edges);
+    free(hl);
+}
+
+int hashGet(HashLife *hl, int y, int x)
+{
+    Node *n = hl->root;
+    long long cx = x - hl->ox;
+    long long cy = y - hl->oy;
+
+    while (n->level > 0){
+        if (!n->alive)
+            return 0;
+        long long half = 1LL << (n->level - 1);
+        if (cy < half)
+            n = cx < half ? n->nw : n->ne;
+        else
+            n = cx < half ? n->sw : n->se;
+        if (cx >= half)
+            cx -= half;
+        if (cy >= half)
+            cy -= half;
+    }
+    return n->alive;
+}
+
+/**
+ * Returns a node with one cell changed.
+ *
+ * @param hl    the grid
+ * @param n     the node
+ * @param x     column of the cell in the node
+ * @param y     row of the cell in the node
+ * @param value the cell's new value
+ * @return the changed node
+ */
+static Node *setCell(HashLife *hl, Node *n, long long x, long long y, int value)
+{
+    if (n->level == 0)
+        return &hl->cells[value];
+
+    long long half = 1LL << (n->level - 1);
+    Node *nw = n->nw, *ne = n->ne, *sw = n->sw, *se = n->se;
+
+    if (y < half && x < half)
+        nw = setCell(hl, nw, x, y, value);
+    else if (y < half)
+        ne = setCell(hl, ne, x - half, y, value);
+    else if (x < half)
+        sw = setCell(hl, sw, x, y - half, value);
+    else
+        se = setCell(hl, se, x - half, y - half, value);
+    return join(hl, nw, ne, sw, se);
+}
+
+void hashSet(HashLife *hl, int y, int x, int value)
+{
+    if (hashGet(hl, y, x) == value)
+        return;
+    hl->root = setCell(hl, hl->root, x - hl->ox, y - hl->oy, value);
+}
+
+void hashStep(HashLife *hl, long long n)
+{
+    //the largest jumps first, then one jump per bit of what is left
+    for (; n >= (1LL << MAX_JUMP); n -= 1LL << MAX_JUMP)
+        jump(hl, MAX_JUMP);
+    for (int k = 0; n > 0; k++, n >>= 1)
+        if (n & 1)
+            jump(hl, k);
+}
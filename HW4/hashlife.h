@@ -0,0 +1,71 @@
+/**
+ * @author David Hines (dhhines)
+ * @file hashlife.h
+ *
+ * HashLife engine for the life library (see life.h, life_create_hash).  The grid is a
+ * quadtree of hash-consed nodes: equal squares anywhere in the grid, at any time, are the
+ * same node, and every node remembers its center square advanced 2^k generations, so large
+ * regular or repeating patterns can be advanced by huge numbers of generations at once.
+ *
+ * The cells outside the grid are always dead, exactly like the ghost perimeter of the bit
+ * packed engine, so both engines give the same grids.  Squares that lie inside the grid
+ * behave the same wherever they are and share one remembered result; squares that cross
+ * the edge of the grid are advanced with their position known and remembered by position.
+ *
+ * Nodes are garbage collected once they take more memory than the cap given to
+ * createHashLife; the remembered results are dropped then and are built up again.
+ */
+
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stddef.h>
+
+typedef struct HashLife_Struct HashLife;
+
+/**
+ * Creates an empty (all dead) HashLife grid.
+ *
+ * @param rows   number of rows in the grid
+ * @param cols   number of columns in the grid
+ * @param memCap bytes of nodes kept before collecting garbage
+ * @return the new grid
+ */
+HashLife *createHashLife(int rows, int cols, size_t memCap);
+
+/**
+ * Frees a HashLife grid and all its nodes.
+ *
+ * @param hl the grid
+ */
+void freeHashLife(HashLife *hl);
+
+/**
+ * Returns the value of a cell (0 based row and column).
+ *
+ * @param hl the grid
+ * @param y  row of the cell
+ * @param x  column of the cell
+ * @return 1 if the cell is alive, 0 otherwise
+ */
+int hashGet(HashLife *hl, int y, int x);
+
+/**
+ * Sets the value of a cell (0 based row and column).
+ *
+ * @param hl    the grid
+ * @param y     row of the cell
+ * @param x     column of the cell
+ * @param value 1 for alive, 0 for dead
+ */
+void hashSet(HashLife *hl, int y, int x, int value);
+
+/**
+ * Advances the grid by a number of generations, as a sum of jumps of 2^k generations.
+ *
+ * @param hl the grid
+ * @param n  number of generations
+ */
+void hashStep(HashLife *hl, long long n);
+
+#endif
@@ -4,250 +4,213 @@
  *
  * This program emulates a game of life simulation in which each cell of a M x N 2-Dimensional
  * array is identified by a 1 or 0.  Each generation of the grid will update every cell based
- * on the contents of its neighbor cells (see rules below).  The initial grid is populated
+ * on the contents of its neighbor cells (see rules in lifelib.c).  The initial grid is populated
  * using an input file provided as an argument on the command line and the number of generations
  * for the game to play out is provided as a second argument on the command line (as an integer).
  *
- * Rules:
- *  - A 1 cell value stays 1 if exactly two or three neighbors are 1 valued.
- *  - A 1 cell value becomes 0 if less than two or greater than three neighbors are 1 valued.
- *  - A 0 cell value becomes 1 if exactly three neighbors are 1 valued.
- *  - A 0 cell value stays 0 if less than three or greater than three neighbors are 1 valued.
+ * The simulation itself is done by the life engine (life.h): a bit packed grid computed by a
+ * fixed team of threads that each own a band of rows and swap between two grid buffers.  This
+ * program loads the input file into the engine, prints the initial grid and then prints every
+ * generation from an observer while the team already works on the next one.  The number of
+ * threads is given with -t (one per core by default) and -p pins each thread to its own core.
  *
- * This program utilizes threads to execute each cell value in parallel which will ultimately
- * populate the final table after the proper number of generations has been executed.
+ * With -H the HashLife engine is used instead (memory for its nodes capped at -m megabytes),
+ * which can run huge numbers of generations of regular patterns.  With -B the byte per cell
+ * engine is used, which runs on AVX-512, AVX2 or plain C depending on the processor
+ * (LIFE_KERNEL=avx2 or scalar forces a narrower kernel).  With -P procs the grid is split into
+ * horizontal strips run by that many forked worker processes (pinned with -p), which only
+ * exchange their boundary rows through shared memory.
  *
- * Compile commands: gcc -Wall -g -std=c99 life.c -o life -lpthread
+ * The input file can be a text grid, an RLE pattern or a binary grid (see gridio.h); it is
+ * mapped into memory and parsed in place.  -e N prints only every Nth generation and -f only
+ * the final one, so the generations in between can be run in one go (HashLife jumps straight
+ * over them, and -T depth[:rows:words] runs the bit packed engine in temporal blocks of depth
+ * generations; -T needs -e or -f and the bit packed engine, so it can't go with -H, -B or
+ * -P).  -c prints a checksum of each grid instead of the grid, and -o writes the final grid to
+ * a file (RLE for a name ending in .rle, binary for .bin, text otherwise).
  *
- * Usage: ./life <input file> <integer for # generations>
+ * Compilation: use provided Makefile
+ *
+ * Usage: ./life [-t threads | -P procs] [-p] [-H | -B] [-m megabytes] [-T depth[:rows:words]] [-e N | -f] [-c]
+ *               [-o output file] <input file> <integer for # generations>
  */
 
+#include "life.h"
+#include "gridio.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/types.h>
 #include <unistd.h>
-#include <pthread.h>
-
-
-//struct for holding the shared data for threads
-typedef struct Data_struct {
-    int currGen; //the current generation
-    int rows;  //number of rows in grid (from )
-    int cols;  //number of columns in grid
-    int trows;  //number of rows including ghost rows
-    int tcols;  //number of columns including ghost columns
-    int **currGrid; //declare pointer to starting gen 2D array; dynamically created later
-    int **nextGenGrid; //declare pointer to next gen 2D array; dynamically created later
-    int m; //the current row in M x N grid to calculate
-    int n; //the current column in M x N grid to calculate
-    int lock;  //0 for unlocked and 1 for locked
-}Data;
+
+//default memory cap for the HashLife nodes, in megabytes
+#define HASH_MB 256
+//size of the buffer for standard output
+#define OUT_BUFFER (1 << 20)
 
 /**
- * This function is used by each thread to calculate the cell it is assigned with the
- * proper next generation value based on the rules provided (see header section). The
- * new value for the cell is set in the nextGenGrid array so as not to change the
- * currGrid values while the other threads work in parallel to update their respective
- * cells.
- *
- * Note: To ensure the threads obtain the proper values of m and n there is a lock in
- * the shared Data struct that is released by the thread once the values are copied to
- * local variables of y and x respectively.
+ * Prints the current generation grid, or its checksum, to the console.
  *
- * @param param  pointer to the parameter passed to the function
+ * @param life     the simulation
+ * @param checksum 1 to print the checksum instead of the grid
  */
-void *genUpdate(void *param)
+void printGrid(Life *life, int checksum)
 {
-    //cast the void param pointer to the Data struct type using new struct declaration
-    Data *t_data = (Data *)param;
-
-    //x is the column
-    int x = t_data->n;
-    //y is the row
-    int y = t_data->m;
-
-    //END LOCK
-    t_data->lock = 0;
-
-    //sum of all neighbors
-    int sum = 0;
-
-    //sum the cells in row above (y - 1)
-    //add to sum the upper left cell (y-1),(x-1)
-    sum += t_data->currGrid[y - 1][x - 1];
-    //add to sum the upper center cell (y-1),(x)
-    sum += t_data->currGrid[y - 1][x];
-    //add to sum the upper right cell (y-1),(x+1)
-    sum += t_data->currGrid[y - 1][x + 1];
-
-    //sum the cells in current row (y)
-    //add to sum the cell behind (y),(x-1)
-    sum += t_data->currGrid[y][x - 1];
-    //add to sum the cell ahead (y),(x+1)
-    sum += t_data->currGrid[y][x + 1];
-
-    //sum the cells in row below (y + 1)
-    //add to sum the lower left cell (y+1),(x-1)
-    sum += t_data->currGrid[y + 1][x - 1];
-    //add to sum the lower center cell (y+1),(x)
-    sum += t_data->currGrid[y + 1][x];
-    //add to sum the lower right cell (y+1),(x+1)
-    sum += t_data->currGrid[y + 1][x + 1];
-
-    //set the cell result in next generation grid
-    if (t_data->currGrid[y][x] == 1){
-        if (sum == 2 || sum == 3)
-            t_data->nextGenGrid[y][x] = 1;
-        else
-            t_data->nextGenGrid[y][x] = 0;
-    }
-    if (t_data->currGrid[y][x] == 0){
-        if (sum == 3)
-            t_data->nextGenGrid[y][x] = 1;
-        else
-            t_data->nextGenGrid[y][x] = 0;
-    }
-
-    sum = 0;
-    pthread_exit(0);
+    if (checksum)
+        printf("Checksum: %016llx\n\n", gridChecksum(life));
+    else
+        writeText(stdout, life);
 }
 
 /**
- * Function that prints the specified version of the grid to the console
+ * Observer run by the engine after every generation: prints the new grid.
  *
- * @param shrdData pointer to the Data struct holding the current generation grid values
- * @param version  char indicating which grid version to print, 'c' current Grid and 'n' next gen grid
+ * @param life the simulation
+ * @param ctx  pointer to the checksum flag
  */
-void printGrid(Data *shrdData, char version)
+void printGen(Life *life, void *ctx)
 {
-
-    for (int i = 1; i < shrdData->trows - 1; i++){
-        for (int j = 1; j < shrdData->tcols - 1; j++)
-            if (version == 'c')
-                printf("%d ", shrdData->currGrid[i][j]);
-            else if (version == 'n')
-                printf("%d ", shrdData->nextGenGrid[i][j]);
-            else
-                printf("Invalid character");
-        printf("\n");
-    }
-    printf("\n");
+    printf("Next Generation Grid #%lld:\n", life_generation(life));
+    printGrid(life, *(int *) ctx);
 }
 
 /**
- * Main program for the life application
- * @param argc the number of arguments passed from commandline
- * @param argv array of character pointers to the argurments entered on the commandline
+ * Returns 1 if a file name ends with an extension.
+ *
+ * @param name the file name
+ * @param ext  the extension, with its dot
  */
-int main(int argc, char *argv[])
+int hasExtension(const char *name, const char *ext)
 {
+    size_t len = strlen(name);
+    size_t extLen = strlen(ext);
+    return len >= extLen && strcmp(name + len - extLen, ext) == 0;
+}
 
-    //Initialize the grid struct to hold the grid array
-    Data *shrdData = (Data *) malloc (sizeof(Data));
+int main(int argc, char *argv[])
+{
+    int numThreads = 0;
+    int numProcs = 0;
+    int pin = 0;
+    int useHash = 0;
+    int useBytes = 0;
+    long hashMB = HASH_MB;
+    long long every = 1;
+    int finalOnly = 0;
+    int checksum = 0;
+    const char *outName = NULL;
+    int depth = 0, blockRows = 0, blockWords = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:P:pHBm:T:e:fco:")) != -1){
+        if (opt == 't' && atoi(optarg) > 0)
+            numThreads = atoi(optarg);
+        else if (opt == 'P' && atoi(optarg) > 0)
+            numProcs = atoi(optarg);
+        else if (opt == 'p')
+            pin = 1;
+        else if (opt == 'H')
+            useHash = 1;
+        else if (opt == 'B')
+            useBytes = 1;
+        else if (opt == 'm' && atol(optarg) > 0)
+            hashMB = atol(optarg);
+        else if (opt == 'T'){
+            if (sscanf(optarg, "%d:%d:%d", &depth, &blockRows, &blockWords) < 1 || depth < 1)
+                optind = argc + 1;
+        }
+        else if (opt == 'e' && atoll(optarg) > 0)
+            every = atoll(optarg);
+        else if (opt == 'f')
+            finalOnly = 1;
+        else if (opt == 'c')
+            checksum = 1;
+        else if (opt == 'o')
+            outName = optarg;
+        else
+            optind = argc + 1;
+    }
+    if (optind != argc - 2){
+        fprintf(stderr, "usage: %s [-t threads | -P procs] [-p] [-H | -B] [-m megabytes] [-T depth[:rows:words]] [-e N | -f] [-c] [-o output file] <input file> <integer for # generations>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
 
-    //set the current generation to 0 for starters
-    shrdData->currGen = 0;
     //set the total number of generations from second command line argument
-    int totalGens = atoi(argv[2]);
-
-    //create file buffer open to the filename passed as first command line argument
-    FILE *fp = fopen(argv[1], "r");
-
-    //scan in the first two values from file which are rows and columns of the lifeGrid (M x N)
-    fscanf(fp, "%d%d", &shrdData->rows, &shrdData->cols);
-
-    //set the total rows and total columns creating the ghost perimeter (will be all zeros)
-    shrdData->trows = shrdData->rows + 2;
-    shrdData->tcols = shrdData->cols + 2;
+    long long totalGens = atoll(argv[optind + 1]);
 
-    //set lock to 0 (open) initially
-    shrdData->lock = 0;
-
-    //create the dynamic memory arrays in the struct using number of rows provided + 2
-    shrdData->currGrid = (int **) malloc ((shrdData->trows) * sizeof(int *));
-    shrdData->nextGenGrid = (int **) malloc ((shrdData->trows) * sizeof(int *));
-
-    //now loop through the rows to create the columns + 2 for each in dynamic memory and zero them
-    for (int i = 0; i < shrdData->trows; i++){
-        shrdData->currGrid[i] = (int *) calloc ((shrdData->tcols), sizeof(int));
-        shrdData->nextGenGrid[i] = (int *) calloc ((shrdData->tcols), sizeof(int));
+    //temporal blocks only run in the bit packed engine, between printed generations
+    if (depth && (useHash || useBytes || numProcs || (every == 1 && !finalOnly))){
+        fprintf(stderr, "-T needs -e N (N > 1) or -f, and can't be used with -H, -B or -P\n");
+        exit(EXIT_FAILURE);
     }
 
-    //use the M x N values for the grid to populate the initial values from the input file for startGrid
-    for (int i = 1; i < shrdData->trows - 1; i++)
-        for (int j = 1; j < shrdData->tcols - 1; j++)
-            fscanf(fp, "%d", &shrdData->currGrid[i][j]);
-
-    fclose(fp);
+    //map the file passed as first command line argument and read the size of the lifeGrid (M x N)
+    GridFile *gf = openGrid(argv[optind]);
+    if (!gf){
+        fprintf(stderr, "Can't read a grid from %s\n", argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+    int rows = gridRows(gf);
+    int cols = gridCols(gf);
+
+    Life *life;
+    if (useHash)
+        life = life_create_hash(rows, cols, (size_t) hashMB << 20);
+    else if (useBytes)
+        life = life_create_bytes(rows, cols);
+    else if (numProcs)
+        life = life_create_procs(rows, cols, numProcs, pin);
+    else
+        life = life_create(rows, cols, numThreads, pin);
+
+    //set the live cells of the initial grid from the file
+    loadGrid(gf, life);
+    closeGrid(gf);
 
     //Print the current generation grid to the console
+    setvbuf(stdout, NULL, _IOFBF, OUT_BUFFER);
     printf("Initial grid:\n");
-    printGrid(shrdData, 'c');
-
-    //array of threads used to calculate generations (2D array to match cell grid for simplicity)
-    pthread_t threads[shrdData->rows][shrdData->cols];
-
-    //set of thread attributes for each worker thread
-    pthread_attr_t attr;
-    //set the thread attributes
-    pthread_attr_init(&attr);
-
-    //Loop for the proper number of generations
-    for (int z = 0; z < totalGens; z++){
-        //set the m and n variables to 0 before threads update the next generation
-        shrdData->m = 0;
-        shrdData->n = 0;
-        shrdData->currGen = z;
-
-        //loop through the total number of threads to have one for each grid cell to be updated
-        for (int i = 1; i < shrdData->trows - 1; i++){
-            for (int j = 1; j < shrdData->tcols - 1; j++ ){
-
-                //NOTE:  Need to create a locking scenario here or in the genUpdate function
-
-                //WAIT FOR UNLOCK
-                while (shrdData->lock == 1);
-                    //do nothing
-
-                //LOCK DATA FOR NEXT THREAD CREATION (thread will unlock once captures m x n values)
-                shrdData->lock = 1;
-
-                //set the m and n variables to the current cell value to be updated by the new thread
-                shrdData->m = i;
-                shrdData->n = j;
-
-                //create the new thread and pass it the id, attr, the function and data struct
-                pthread_create(&threads[i][j], &attr, genUpdate, shrdData);
-            }
+    printGrid(life, checksum);
+
+    //run the generations, printing only the last, each one as it completes, or only every Nth
+    //one and the last
+    if (finalOnly){
+        life_temporal(life, depth, blockRows, blockWords);
+        if (totalGens > 0){
+            life_step(life, totalGens);
+            printf("Next Generation Grid #%lld:\n", life_generation(life));
+            printGrid(life, checksum);
         }
-
-        //thread join for each thread ID when each thread completes its task
-        for (int i = 1; i < shrdData->trows - 1; i++)
-            for (int j = 1; j < shrdData->tcols - 1 ; j++)
-                pthread_join(threads[i][j], NULL);
-
-        //print the next generation grid just produced
-        printf("Next Generation Grid #%d:\n", shrdData->currGen + 1);
-        printGrid(shrdData, 'n');
-
-        //copy the nextGenGrid data to the currGrid data and zero out the nextGenGrid for next generation
-        for(int i = 0; i < shrdData->trows; i++){
-            memmove(shrdData->currGrid[i], shrdData->nextGenGrid[i], (shrdData->tcols) * sizeof(int));
-            memset(shrdData->nextGenGrid[i], 0, (shrdData->tcols) * sizeof(int));
+    }
+    else if (every == 1){
+        life_observe(life, printGen, &checksum);
+        life_step(life, totalGens);
+    }
+    else {
+        life_temporal(life, depth, blockRows, blockWords);
+        for (long long done = 0; done < totalGens; done += every){
+            life_step(life, totalGens - done < every ? totalGens - done : every);
+            printf("Next Generation Grid #%lld:\n", life_generation(life));
+            printGrid(life, checksum);
         }
     }
 
-    //free the memory for each dynamic array in the Data struct
-    for (int i = 0; i < shrdData->trows; i++){
-        free(shrdData->currGrid[i]);
-        free(shrdData->nextGenGrid[i]);
+    if (outName){
+        FILE *out = fopen(outName, "wb");
+        if (!out){
+            fprintf(stderr, "Can't open file %s\n", outName);
+            exit(EXIT_FAILURE);
+        }
+        if (hasExtension(outName, ".rle"))
+            writeRLE(out, life);
+        else if (hasExtension(outName, ".bin"))
+            writeBinary(out, life);
+        else {
+            fprintf(out, "%d %d\n", rows, cols);
+            writeText(out, life);
+        }
+        fclose(out);
     }
-    free(shrdData->currGrid);
-    free(shrdData->nextGenGrid);
-
-    //free memory for the Data struct
-    free(shrdData);
 
+    life_free(life);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,185 @@
+/**
+ * @author David Hines (dhhines)
+ * @file life.h
+ *
+ * Game of life engine used by the life program and usable as a library.  The grid is bit
+ * packed (64 cells per uint64_t word) with a ghost perimeter of dead cells, and every
+ * generation is computed by a persistent team of threads that each own a band of rows.
+ * Two grid buffers are kept and swapped after each generation, so nothing is copied or
+ * cleared between generations.  Tiles of the grid that cannot change are skipped, and a
+ * grid that settles into a cycle is fast-forwarded.
+ *
+ * Cells are addressed with 0 based row and column numbers.  The cells outside the grid are
+ * always dead.
+ *
+ * life_create_hash makes a simulation run by the HashLife engine (hashlife.h) instead, which
+ * gives the same grids and can jump over huge numbers of generations of regular patterns.
+ * life_create_bytes makes one run by the byte per cell engine (bytelife.h), computed with the
+ * widest vector instructions the processor has.  life_create_procs makes one run by forked
+ * worker processes that each own a horizontal strip (striplife.h).
+ */
+
+#ifndef LIFE_H
+#define LIFE_H
+
+#include <stddef.h>
+
+typedef struct Life_struct Life;
+
+/**
+ * Function called after every generation, while the team works on the next one.  It may
+ * read the grid (life_get) but must not change it.
+ *
+ * @param life the simulation
+ * @param ctx  context pointer given to life_observe
+ */
+typedef void (*LifeObserver)(Life *life, void *ctx);
+
+/**
+ * Creates an empty (all dead) grid and starts the team of threads.
+ *
+ * @param rows       number of rows in the grid
+ * @param cols       number of columns in the grid
+ * @param numThreads number of threads in the team (0 for one per core); the calling thread
+ *  is one of them
+ * @param pin        1 to pin each thread, the caller included, to its own core
+ * @return the new simulation, or NULL if the size is invalid
+ */
+Life *life_create(int rows, int cols, int numThreads, int pin);
+
+/**
+ * Creates an empty (all dead) grid run by the HashLife engine.  There is no team; a
+ * life_step without an observer jumps over all its generations at once.  Cycles are not
+ * tracked (life_period is always 0), they are cheap for HashLife anyway.
+ *
+ * @param rows   number of rows in the grid
+ * @param cols   number of columns in the grid
+ * @param memCap bytes of nodes kept before the engine collects garbage
+ * @return the new simulation, or NULL if the size is invalid
+ */
+Life *life_create_hash(int rows, int cols, size_t memCap);
+
+/**
+ * Creates an empty (all dead) grid of one byte per cell, run by the byte per cell engine.
+ * There is no team and cycles are not tracked (life_period is always 0).
+ *
+ * @param rows number of rows in the grid
+ * @param cols number of columns in the grid
+ * @return the new simulation, or NULL if the size is invalid
+ */
+Life *life_create_bytes(int rows, int cols);
+
+/**
+ * Creates an empty (all dead) grid split into horizontal strips, each run by its own forked
+ * worker process, for grids too large for one NUMA node.  Cycles are not tracked
+ * (life_period is always 0).
+ *
+ * @param rows     number of rows in the grid
+ * @param cols     number of columns in the grid
+ * @param numProcs number of worker processes (0 for one per core)
+ * @param pin      1 to pin each worker to its own core, so its strip is allocated on its node
+ * @return the new simulation, or NULL if the size is invalid
+ */
+Life *life_create_procs(int rows, int cols, int numProcs, int pin);
+
+/**
+ * Stops the team and frees the simulation.
+ *
+ * @param life the simulation
+ */
+void life_free(Life *life);
+
+/**
+ * Returns the number of rows in the grid.
+ */
+int life_rows(const Life *life);
+
+/**
+ * Returns the number of columns in the grid.
+ */
+int life_cols(const Life *life);
+
+/**
+ * Returns the number of generations run so far.
+ */
+long long life_generation(const Life *life);
+
+/**
+ * Returns the value of a cell of the current generation.
+ *
+ * @param life the simulation
+ * @param y    row of the cell
+ * @param x    column of the cell
+ * @return 1 if the cell is alive, 0 otherwise
+ */
+int life_get(const Life *life, int y, int x);
+
+/**
+ * Copies one row of the current generation, one cell per byte.
+ *
+ * @param life  the simulation
+ * @param y     the row
+ * @param cells where to copy the row (one byte per column), 1 for alive and 0 for dead
+ */
+void life_row(const Life *life, int y, unsigned char *cells);
+
+/**
+ * Sets the value of a cell of the current generation.  Only call between steps.
+ *
+ * @param life  the simulation
+ * @param y     row of the cell
+ * @param x     column of the cell
+ * @param value 1 for alive, 0 for dead
+ */
+void life_set(Life *life, int y, int x, int value);
+
+/**
+ * Returns the period of the cycle the grid was found to be in (1 for a grid that no longer
+ * changes), or 0 if no cycle has been found.  Once a cycle is found the rest of a life_step
+ * is fast-forwarded instead of calculated where possible.
+ */
+int life_period(const Life *life);
+
+/**
+ * Turns cycle detection on (the default) or off for the bit packed engine (the other engines
+ * don't track cycles).  With it off every generation is calculated, even once the grid has
+ * stopped changing, and life_period stays 0; benchmarks use this to time stepping rather than
+ * fast-forwarding.  Only call between steps.
+ *
+ * @param life the simulation
+ * @param on   1 to look for cycles, 0 not to
+ */
+void life_cycles(Life *life, int on);
+
+/**
+ * Turns temporal blocking on or off for the bit packed engine (the other engines ignore it).
+ * With it on, a life_step without an observer advances blocks of blockRows x blockWords words
+ * depth generations at a time in a small scratch grid, so a grid much larger than the caches
+ * is only read and written once per depth generations.  Tiles are not skipped and cycles
+ * are not looked for while blocking.  Only call between steps.
+ *
+ * @param life       the simulation
+ * @param depth      generations per block (the halo depth), 0 to turn blocking off
+ * @param blockRows  rows of a block, 0 for the default
+ * @param blockWords words (64 cells) of a block, 0 for the default
+ */
+void life_temporal(Life *life, int depth, int blockRows, int blockWords);
+
+/**
+ * Sets the function called after every generation.
+ *
+ * @param life     the simulation
+ * @param observer the function, or NULL for none
+ * @param ctx      context pointer passed to the function
+ */
+void life_observe(Life *life, LifeObserver observer, void *ctx);
+
+/**
+ * Runs generations.
+ *
+ * @param life the simulation
+ * @param n    number of generations to run
+ */
+void life_step(Life *life, long long n);
+
+#endif
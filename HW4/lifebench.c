@@ -0,0 +1,434 @@
+/**
+ * @author David Hines (dhhines)
+ * @file lifebench.c
+ *
+ * Benchmark for the life engines.  Boards are generated from a seed, so every build runs
+ * exactly the same workloads:
+ *  - random: every cell alive with probability 1/3
+ *  - guns: a Gosper glider gun in every 128 x 128 block (regular, busy)
+ *  - acorn: one acorn in the center (a small methuselah on a mostly dead board)
+ * Square boards go from the smallest to the largest size, 4 times larger each step, and the
+ * largest size is always run.  Every engine runs on every board with every thread count it
+ * takes (the threaded engine and the multi-process engine; the others run once), in a forked
+ * child of its own so the peak RSS reported is the configuration's alone.
+ *
+ * Each run gets enough generations for about budget cell updates (at least 4), and only the
+ * life_step is timed.  Cycle detection is turned off (life_cycles), so a board that settles
+ * down is still stepped every generation instead of fast-forwarded.  One CSV line is written
+ * per run: cells per second, generations per second, peak RSS (of the largest process),
+ * scaling efficiency (speed over the 1 thread speed, divided by the number of threads), a
+ * checksum of the final grid and whether it matches the first run on the same board.  The
+ * checksum has to be the same for every engine and thread count; any mismatch is reported
+ * and makes the benchmark exit with a failure.
+ * Progress goes to standard error.
+ *
+ * Configurations whose grids would not fit in the memory limit are skipped, and HashLife only
+ * runs random boards up to -h (its nodes grow with the disorder of the board).
+ *
+ * Compilation: use provided Makefile
+ *              -usage: "make lifebench" or "make bench" (writes lifebench.csv)
+ *
+ * Usage: ./lifebench [-s min size] [-S max size] [-b budget] [-e engines] [-k kinds]
+ *                    [-t thread counts] [-r seed] [-h hash max size] [-M megabytes] [-o csv file]
+ *        engines: bit,temporal,hash,bytes,procs  kinds: random,guns,acorn  thread counts: 1,2,4
+ */
+
+#include "life.h"
+#include "gridio.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+//default smallest and largest board sides
+#define MIN_SIZE 64
+#define MAX_SIZE 32768
+//default cell updates per run
+#define BUDGET 2000000000LL
+//fewest generations per run
+#define MIN_GENS 4
+//default largest random board for HashLife
+#define HASH_MAX 1024
+//memory cap for the HashLife nodes
+#define HASH_MB 256
+//generations per temporal block
+#define TEMPORAL_DEPTH 8
+//most thread counts in a list
+#define MAX_COUNTS 16
+
+//result a child sends back to the parent
+typedef struct Result_Struct {
+    long long gens;
+    double secs;
+    unsigned long long checksum;
+    long workerRss;  //peak RSS of the largest worker process, in kilobytes
+}Result;
+
+/**
+ * Returns the current time in seconds.
+ */
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns the next number of a seeded generator (64 bit PCG output, xorshifted).
+ *
+ * @param state the generator
+ */
+uint32_t nextRandom(uint64_t *state)
+{
+    uint64_t old = *state;
+    *state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint32_t shifted = (uint32_t) (((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t) (old >> 59);
+    return (shifted >> rot) | (shifted << ((-rot) & 31));
+}
+
+/**
+ * Sets the live cells of a pattern drawn with 'O' for alive, clipped to the grid.
+ *
+ * @param life    the simulation
+ * @param pattern rows of the pattern
+ * @param lines   number of rows
+ * @param y       row of the pattern's top left cell
+ * @param x       column of the pattern's top left cell
+ */
+void stamp(Life *life, const char **pattern, int lines, int y, int x)
+{
+    for (int i = 0; i < lines; i++)
+        for (int j = 0; pattern[i][j]; j++)
+            if (pattern[i][j] == 'O' && y + i < life_rows(life) && x + j < life_cols(life))
+                life_set(life, y + i, x + j, 1);
+}
+
+/**
+ * Sets up one of the generated boards in an all dead simulation.
+ *
+ * @param life the simulation
+ * @param kind random, guns or acorn
+ * @param seed seed of the random board
+ */
+void fillBoard(Life *life, const char *kind, uint64_t seed)
+{
+    static const char *gun[] = {
+        "........................O...........",
+        "......................O.O...........",
+        "............OO......OO............OO",
+        "...........O...O....OO............OO",
+        "OO........O.....O...OO..............",
+        "OO........O...O.OO....O.O...........",
+        "..........O.....O.......O...........",
+        "...........O...O....................",
+        "............OO......................"
+    };
+    static const char *acorn[] = { ".O.....", "...O...", "OO..OOO" };
+    int rows = life_rows(life);
+    int cols = life_cols(life);
+
+    if (strcmp(kind, "random") == 0){
+        uint64_t state = seed * 2 + 1;
+        for (int i = 0; i < rows; i++)
+            for (int j = 0; j < cols; j++)
+                if (nextRandom(&state) % 3 == 0)
+                    life_set(life, i, j, 1);
+    }
+    else if (strcmp(kind, "guns") == 0){
+        for (int i = 0; i < rows; i += 128)
+            for (int j = 0; j < cols; j += 128)
+                stamp(life, gun, 9, i + 8, j + 8);
+    }
+    else
+        stamp(life, acorn, 3, rows / 2 - 1, cols / 2 - 3);
+}
+
+/**
+ * Creates an all dead simulation run by an engine.
+ *
+ * @param engine  bit, temporal, hash, bytes or procs
+ * @param size    side of the board
+ * @param threads threads or processes
+ * @return the new simulation
+ */
+Life *createEngine(const char *engine, int size, int threads)
+{
+    Life *life;
+    if (strcmp(engine, "hash") == 0)
+        life = life_create_hash(size, size, (size_t) HASH_MB << 20);
+    else if (strcmp(engine, "bytes") == 0)
+        life = life_create_bytes(size, size);
+    else if (strcmp(engine, "procs") == 0)
+        life = life_create_procs(size, size, threads, 0);
+    else {
+        life = life_create(size, size, threads, 0);
+        if (strcmp(engine, "temporal") == 0)
+            life_temporal(life, TEMPORAL_DEPTH, 0, 0);
+    }
+    //time the stepping, not the fast-forward of a grid found to be in a cycle
+    life_cycles(life, 0);
+    return life;
+}
+
+/**
+ * Returns the bytes of grid an engine needs for a board, to skip runs that won't fit.
+ *
+ * @param engine the engine
+ * @param size   side of the board
+ */
+double gridBytes(const char *engine, int size)
+{
+    double rows = size + 2.0;
+    if (strcmp(engine, "bytes") == 0)
+        return 2 * rows * (size + 66.0);
+    if (strcmp(engine, "hash") == 0)
+        return HASH_MB * 1048576.0;
+    //two bit packed buffers and the tile generations
+    return 2 * rows * (size / 64 + 3) * 8.0 + rows / 64 * (size / 64 + 3) * 8.0;
+}
+
+/**
+ * Runs one configuration in a forked child.
+ *
+ * @param engine  the engine
+ * @param kind    the board
+ * @param size    side of the board
+ * @param threads threads or processes
+ * @param gens    generations to run
+ * @param seed    seed of the random board
+ * @param result  where to store the child's result
+ * @return peak RSS of the child or its largest worker in kilobytes, or -1 if it failed
+ */
+long runConfig(const char *engine, const char *kind, int size, int threads, long long gens,
+               uint64_t seed, Result *result)
+{
+    int fds[2];
+    if (pipe(fds) < 0){
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0){
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0){
+        close(fds[0]);
+        Life *life = createEngine(engine, size, threads);
+        fillBoard(life, kind, seed);
+
+        Result res;
+        double start = now();
+        life_step(life, gens);
+        res.secs = now() - start;
+        res.gens = life_generation(life);
+        res.checksum = gridChecksum(life);
+        life_free(life);
+
+        //the multi-process engine's workers are reaped by life_free
+        struct rusage workers;
+        getrusage(RUSAGE_CHILDREN, &workers);
+        res.workerRss = workers.ru_maxrss;
+
+        if (write(fds[1], &res, sizeof(res)) != sizeof(res))
+            _exit(EXIT_FAILURE);
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(Result));
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || got != sizeof(Result)
+        || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        return -1;
+    return usage.ru_maxrss > result->workerRss ? usage.ru_maxrss : result->workerRss;
+}
+
+/**
+ * Returns 1 if a comma separated list holds a name.
+ */
+int inList(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += len)
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    return 0;
+}
+
+/**
+ * Main program for the life engine benchmark
+ * @param argc the number of arguments passed from commandline
+ * @param argv the array of strings passed from commandline
+ * @return exit status
+ */
+int main(int argc, char *argv[])
+{
+    static const char *engines[] = { "bit", "temporal", "hash", "bytes", "procs" };
+    static const char *kinds[] = { "random", "guns", "acorn" };
+    int minSize = MIN_SIZE;
+    int maxSize = MAX_SIZE;
+    long long budget = BUDGET;
+    const char *engineList = "bit,temporal,hash,bytes,procs";
+    const char *kindList = "random,guns,acorn";
+    const char *countList = NULL;
+    uint64_t seed = 1;
+    int hashMax = HASH_MAX;
+    double memLimit = (double) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) * 3 / 4;
+    const char *outName = NULL;
+    int mismatches = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:S:b:e:k:t:r:h:M:o:")) != -1){
+        switch (opt){
+        case 's':
+            minSize = atoi(optarg);
+            break;
+        case 'S':
+            maxSize = atoi(optarg);
+            break;
+        case 'b':
+            budget = atoll(optarg);
+            break;
+        case 'e':
+            engineList = optarg;
+            break;
+        case 'k':
+            kindList = optarg;
+            break;
+        case 't':
+            countList = optarg;
+            break;
+        case 'r':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'h':
+            hashMax = atoi(optarg);
+            break;
+        case 'M':
+            memLimit = atof(optarg) * 1048576;
+            break;
+        case 'o':
+            outName = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s min size] [-S max size] [-b budget] [-e engines] [-k kinds] [-t thread counts] [-r seed] [-h hash max size] [-M megabytes] [-o csv file]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (minSize < 1 || maxSize < minSize || budget < 1){
+        fprintf(stderr, "Invalid sizes or budget\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //thread counts: the list given, or 1 and the powers of two up to the number of cores
+    int counts[MAX_COUNTS];
+    int numCounts = 0;
+    if (countList){
+        for (const char *p = countList; *p && numCounts < MAX_COUNTS; p += strcspn(p, ","), p += *p == ',')
+            if (atoi(p) > 0)
+                counts[numCounts++] = atoi(p);
+    }
+    else {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int t = 1; t <= cores && numCounts < MAX_COUNTS; t *= 2)
+            counts[numCounts++] = t;
+        if (cores > counts[numCounts - 1] && numCounts < MAX_COUNTS)
+            counts[numCounts++] = (int) cores;
+    }
+    if (numCounts == 0)
+        counts[numCounts++] = 1;
+
+    FILE *out = outName ? fopen(outName, "w") : stdout;
+    if (!out){
+        fprintf(stderr, "Can't open file %s\n", outName);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(out, "engine,kind,rows,cols,threads,generations,seconds,cells_per_sec,gens_per_sec,peak_rss_kb,efficiency,checksum,checksum_match\n");
+
+    for (int size = minSize; ; size = size * 4 < maxSize ? size * 4 : maxSize){
+        double cells = (double) size * size;
+        long long gens = (long long) (budget / cells);
+        if (gens < MIN_GENS)
+            gens = MIN_GENS;
+
+        for (int k = 0; k < 3; k++){
+            if (!inList(kindList, kinds[k]))
+                continue;
+            //checksum of the first run on this board, which every other run has to match
+            unsigned long long expected = 0;
+            const char *expectedBy = NULL;
+            for (int e = 0; e < 5; e++){
+                const char *engine = engines[e];
+                int threaded = strcmp(engine, "bit") == 0 || strcmp(engine, "temporal") == 0
+                            || strcmp(engine, "procs") == 0;
+                if (!inList(engineList, engine))
+                    continue;
+                if (gridBytes(engine, size) > memLimit
+                    || (strcmp(engine, "hash") == 0 && strcmp(kinds[k], "random") == 0 && size > hashMax)){
+                    fprintf(stderr, "%-8s %-6s %6d: skipped\n", engine, kinds[k], size);
+                    continue;
+                }
+
+                //speed with the first thread count, for the scaling efficiency
+                double baseRate = 0;
+                int baseThreads = 0;
+                for (int c = 0; c < (threaded ? numCounts : 1); c++){
+                    int threads = threaded ? counts[c] : 1;
+                    Result res;
+                    long rss = runConfig(engine, kinds[k], size, threads, gens, seed, &res);
+                    if (rss < 0){
+                        fprintf(stderr, "%-8s %-6s %6d x%d: failed\n", engine, kinds[k], size, threads);
+                        continue;
+                    }
+
+                    double rate = res.secs > 0 ? cells * res.gens / res.secs : 0;
+                    if (!baseThreads){
+                        baseRate = rate;
+                        baseThreads = threads;
+                    }
+                    double efficiency = baseRate > 0 ? rate / baseRate * baseThreads / threads : 0;
+                    if (!expectedBy){
+                        expected = res.checksum;
+                        expectedBy = engine;
+                    }
+                    int match = res.checksum == expected;
+                    if (!match){
+                        fprintf(stderr, "%-8s %-6s %6d x%d: checksum %016llx, %s had %016llx\n",
+                                engine, kinds[k], size, threads, res.checksum, expectedBy, expected);
+                        mismatches++;
+                    }
+
+                    fprintf(out, "%s,%s,%d,%d,%d,%lld,%.6f,%.6g,%.6g,%ld,%.3f,%016llx,%d\n",
+                            engine, kinds[k], size, size, threads, res.gens, res.secs, rate,
+                            res.secs > 0 ? res.gens / res.secs : 0, rss, efficiency, res.checksum,
+                            match);
+                    fflush(out);
+                    fprintf(stderr, "%-8s %-6s %6d x%-3d %8lld gens %9.3f s %10.3g cells/s %8ld KB\n",
+                            engine, kinds[k], size, threads, res.gens, res.secs, rate, rss);
+                }
+            }
+        }
+        if (size == maxSize)
+            break;
+    }
+
+    if (out != stdout)
+        fclose(out);
+    if (mismatches){
+        fprintf(stderr, "%d runs ended with a different checksum\n", mismatches);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
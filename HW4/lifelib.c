@@ -0,0 +1,962 @@
+/**
+ * @author David Hines (dhhines)
+ * @file lifelib.c
+ *
+ * Implementation of the game of life engine (see life.h).
+ *
+ * Rules:
+ *  - A 1 cell value stays 1 if exactly two or three neighbors are 1 valued.
+ *  - A 1 cell value becomes 0 if less than two or greater than three neighbors are 1 valued.
+ *  - A 0 cell value becomes 1 if exactly three neighbors are 1 valued.
+ *  - A 0 cell value stays 0 if less than three or greater than three neighbors are 1 valued.
+ *
+ * Each row is stored as 64 cells per uint64_t word and all rows live in one contiguous array.
+ * Every row has a ghost word on each side and there is a ghost row above and below the grid.
+ * Only the words inside the grid are ever written, so the ghosts of both buffers stay 0 and
+ * the buffers can simply be swapped after each generation.
+ *
+ * The team meets at one barrier per generation.  Every thread keeps its own pointers to the
+ * source and destination buffers and swaps them after the barrier, so no thread has to wait
+ * for a shared swap; thread 0 publishes the new current grid and runs the observer while the
+ * rest of the team already works on the next generation (which only reads that grid).
+ *
+ * The grid is also split into tiles of 64 rows by one word (64 x 64 cells) and every tile
+ * records the last generation it changed in.  A tile whose 3 x 3 block of tiles did not change
+ * in the last generation cannot change in the next one, so it is skipped; the other buffer
+ * already holds the same cells because the tile did not change.  Mostly dead or settled boards
+ * then cost almost nothing per generation.
+ *
+ * Thread 0 keeps a hash of the grid, updated from the words each generation changed, and a
+ * short history of it.  When the hash repeats after p generations the grid is copied and
+ * compared exactly p generations later; a match means the board has entered a cycle of period
+ * p and the rest of the run is fast-forwarded (see life_step).  Hashing every calculated word
+ * costs a fair share of a generation, so the hash is only kept for windows of HASH_WINDOW
+ * generations; the gap between windows doubles each time one ends without a cycle, so a busy
+ * board soon stops paying for it.  A generation that changes nothing is a cycle of period 1
+ * whether the hash is kept or not.
+ *
+ * Large grids can be run temporally blocked instead (life_temporal): each thread copies a
+ * block of its band, with a halo of depth rows and depth cells on every side, into a small
+ * scratch grid and advances it depth generations there before writing the block back, so the
+ * grid goes through memory once per depth generations instead of once per generation.  The
+ * halo is what the block's cells depend on over that many generations; the halo cells
+ * themselves go wrong from the outside in, one cell per generation, and are thrown away.
+ *
+ * A simulation made with life_create_hash, life_create_bytes or life_create_procs has no grids
+ * or team at all and hands every call to the HashLife engine (hashlife.c), the byte per cell
+ * engine (bytelife.c) or the multi-process engine (striplife.c) instead.
+ */
+
+#include "life.h"
+#include "lifeword.h"
+#include "hashlife.h"
+#include "bytelife.h"
+#include "striplife.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+//number of rows in a tile (a tile is one word wide)
+#define TILE_ROWS 64
+//number of past grid hashes searched for a repeat (the longest period detected)
+#define HASH_HISTORY 64
+//number of generations the hash is kept for at a time
+#define HASH_WINDOW (2 * HASH_HISTORY)
+//longest gap between hash windows
+#define HASH_GAP_MAX (16 * HASH_WINDOW)
+//default rows and words of a temporal block
+#define BLOCK_ROWS 256
+#define BLOCK_WORDS 16
+
+//parameters handed to each thread of the team
+typedef struct Worker_struct {
+    Life *life;  //the shared simulation
+    int id;  //index of the thread in the team (0 is the caller of life_step)
+    int firstRow;  //first row of the thread's band (1 to rows)
+    int lastRow;  //last row of the thread's band
+    unsigned char *active;  //tiles of the current tile row to calculate, by word
+    uint64_t *diff;  //bits changed in each tile of the current tile row, by word
+    uint64_t hashDelta[2];  //change of the grid hash by the band, by generation parity
+    int changed[2];  //1 if the band changed, by generation parity
+    uint64_t *scratch;  //two scratch grids for temporal blocks
+}Worker;
+
+//struct for holding the shared data for threads
+struct Life_struct {
+    long long currGen;  //generations run so far
+    int rows;  //number of rows in grid
+    int cols;  //number of columns in grid
+    int trows;  //number of rows including ghost rows
+    int words;  //number of words holding the cells of a row
+    int stride;  //number of words in a row including the two ghost words
+    uint64_t lastMask;  //bits of the last word of a row that are inside the grid
+    uint64_t *currGrid;  //trows x stride words for the current generation
+    uint64_t *nextGenGrid;  //trows x stride words the next generation is written to
+    int tileRows;  //number of tile rows
+    long long *tileGen;  //last generation each tile changed in, with a border of tiles
+    uint64_t hash;  //hash of the current grid (sum of each word times wordWeight)
+    int hashValid;  //1 if hash is up to date
+    int hashing[2];  //1 if the generation's step updates the hash, by generation parity
+    long long hashFrom;  //generation the current or next hash window starts at
+    long long hashUntil;  //generation the current or next hash window ends at
+    long long hashGap;  //generations between the current window and the next one
+    uint64_t hashHist[HASH_HISTORY];  //hashes of the last generations, by generation
+    int histLen;  //number of valid entries in hashHist
+    uint64_t *snapshot;  //copy of the grid when a repeated hash was seen
+    long long snapGen;  //generation of the snapshot, -1 for none
+    int snapPeriod;  //period the snapshot is checked for
+    int period;  //period of the cycle the grid is in, 0 if not known
+    int noCycles;  //1 if cycles are not looked for (life_cycles)
+    int stop[2];  //1 to stop after the barrier, by generation parity
+    LifeObserver observer;  //called after every generation
+    void *ctx;  //context for the observer
+    int numThreads;  //size of the team
+    int pin;  //1 to pin each thread to its own core
+    long long pending;  //generations the current life_step asked for
+    int quit;  //1 once the team should exit
+    pthread_barrier_t start;  //where the team waits for the next life_step
+    pthread_barrier_t barrier;  //where the team meets between generations
+    pthread_t *threads;
+    Worker *team;
+    int blockDepth;  //generations per temporal block, 0 to step one generation at a time
+    int blockRows;  //rows of a temporal block
+    int blockWords;  //words of a temporal block
+    HashLife *hashLife;  //HashLife engine, NULL for the bit packed one
+    ByteLife *byteLife;  //byte per cell engine, NULL for the bit packed one
+    StripLife *stripLife;  //multi-process engine, NULL for the bit packed one
+};
+
+/**
+ * Returns the weight of one word in the grid hash.  The hash is the sum of every word times
+ * its weight, so a word changing from a to b changes the hash by (b - a) times the weight
+ * and an empty grid hashes to 0.  It only has to make repeats of the grid rare enough; a
+ * repeat is always confirmed by comparing the grids.
+ *
+ * @param i index of the word in the grid
+ * @return the weight (odd)
+ */
+static inline uint64_t wordWeight(size_t i)
+{
+    return ((uint64_t) i * 0x9E3779B97F4A7C15ULL) | 1;
+}
+
+/**
+ * Returns the last-changed generation of a tile.
+ *
+ * @param life the simulation
+ * @param tr   tile row (-1 to tileRows)
+ * @param w    word of the tile (0 to words + 1)
+ */
+static inline long long *tileAt(const Life *life, int tr, int w)
+{
+    return &life->tileGen[(size_t) (tr + 1) * life->stride + w];
+}
+
+/**
+ * Marks every tile as changed in the current generation, so all of them are calculated in
+ * the next one.
+ *
+ * @param life the simulation
+ */
+static void markAll(Life *life)
+{
+    for (int tr = 0; tr < life->tileRows; tr++)
+        for (int w = 1; w <= life->words; w++)
+            *tileAt(life, tr, w) = life->currGen;
+}
+
+/**
+ * Starts the hash windows over from the current generation, after the grid was changed
+ * from outside.
+ *
+ * @param life the simulation
+ */
+static void restartWindows(Life *life)
+{
+    life->hashFrom = life->currGen;
+    life->hashUntil = life->currGen + HASH_WINDOW;
+    life->hashGap = HASH_WINDOW;
+}
+
+/**
+ * Calculates the next generation of the tiles of one row that are to be calculated.  Always
+ * inlined with constant flags so each combination gets its own loop.
+ *
+ * @param life    the simulation
+ * @param row     the row to calculate in the grid being read
+ * @param next    the same row in the grid being written
+ * @param base    index of the row's first word in the grid, for the hash
+ * @param active  tiles to calculate, by word
+ * @param diff    bits changed in each tile, by word
+ * @param all     1 if every tile of the row is to be calculated
+ * @param hashing 1 to add up the change of the grid hash
+ * @return the change of the grid hash
+ */
+static inline __attribute__((always_inline))
+uint64_t stepTiles(const Life *life, const uint64_t *row, uint64_t *restrict next, size_t base,
+                   const unsigned char *active, uint64_t *restrict diff, const int all, const int hashing)
+{
+    const uint64_t *above = row - life->stride;
+    const uint64_t *below = row + life->stride;
+    int words = life->words;
+    uint64_t hashDelta = 0;
+
+    for (int w = 1; w <= words; w++){
+        if (!all && !active[w])
+            continue;
+        uint64_t value = stepWord(above, row, below, w);
+        //keep the columns past the edge of the grid dead
+        if (w == words)
+            value &= life->lastMask;
+        next[w] = value;
+        diff[w] |= value ^ row[w];
+        if (hashing)
+            hashDelta += (value - row[w]) * wordWeight(base + w);
+    }
+    return hashDelta;
+}
+
+/**
+ * Calculates the next generation of the thread's band of rows, skipping the tiles whose
+ * 3 x 3 block of tiles did not change in the last generation.  Records the tiles that change,
+ * and the change of the grid hash, for the next generation.
+ *
+ * @param me  the thread's Worker
+ * @param src the grid to read
+ * @param dst the grid to write
+ * @param gen generation of src
+ * @param hashing 1 to add up the change of the grid hash
+ */
+static void stepBand(Worker *me, const uint64_t *src, uint64_t *dst, long long gen, int hashing)
+{
+    Life *life = me->life;
+    int stride = life->stride;
+    int words = life->words;
+    uint64_t hashDelta = 0;
+    int changed = 0;
+
+    for (int tr = (me->firstRow - 1) / TILE_ROWS; tr <= (me->lastRow - 1) / TILE_ROWS; tr++){
+        int y0 = 1 + tr * TILE_ROWS > me->firstRow ? 1 + tr * TILE_ROWS : me->firstRow;
+        int y1 = (tr + 1) * TILE_ROWS < me->lastRow ? (tr + 1) * TILE_ROWS : me->lastRow;
+        int count = 0;
+
+        //a tile is calculated if it or a tile next to it changed in the last generation
+        for (int w = 1; w <= words; w++){
+            long long last = -1;
+            for (int t = tr - 1; t <= tr + 1; t++)
+                for (int u = w - 1; u <= w + 1; u++){
+                    long long g = __atomic_load_n(tileAt(life, t, u), __ATOMIC_RELAXED);
+                    if (g > last)
+                        last = g;
+                }
+            me->active[w] = last >= gen;
+            me->diff[w] = 0;
+            count += me->active[w];
+        }
+        if (!count)
+            continue;
+
+        for (int y = y0; y <= y1; y++){
+            const uint64_t *row = src + (size_t) y * stride;
+            uint64_t *next = dst + (size_t) y * stride;
+            size_t base = (size_t) y * stride;
+
+            if (count == words){
+                if (hashing)
+                    hashDelta += stepTiles(life, row, next, base, me->active, me->diff, 1, 1);
+                else
+                    stepTiles(life, row, next, base, me->active, me->diff, 1, 0);
+            }
+            else if (hashing)
+                hashDelta += stepTiles(life, row, next, base, me->active, me->diff, 0, 1);
+            else
+                stepTiles(life, row, next, base, me->active, me->diff, 0, 0);
+        }
+
+        for (int w = 1; w <= words; w++)
+            if (me->diff[w]){
+                __atomic_store_n(tileAt(life, tr, w), gen + 1, __ATOMIC_RELAXED);
+                changed = 1;
+            }
+    }
+
+    me->hashDelta[(gen + 1) & 1] = hashDelta;
+    me->changed[(gen + 1) & 1] = changed;
+}
+
+/**
+ * Advances the thread's band of rows d generations at once, one block at a time (see above).
+ * The scratch grids have a frame of one row and one word around the halo, outside of which
+ * nothing is read; rows and words outside the grid are copied in as 0 and never written, so
+ * they stay dead like the ghost perimeter.
+ *
+ * @param me  the thread's Worker
+ * @param src the grid to read
+ * @param dst the grid to write, d generations after src
+ * @param d   number of generations (1 to blockDepth)
+ */
+static void stepBlocks(Worker *me, const uint64_t *src, uint64_t *dst, int d)
+{
+    Life *life = me->life;
+    int stride = life->stride;
+    int words = life->words;
+    int haloWords = (life->blockDepth + WORD_BITS - 1) / WORD_BITS;
+    int scratchStride = life->blockWords + 2 * haloWords + 2;
+    size_t scratchWords = (size_t) (life->blockRows + 2 * life->blockDepth + 2) * scratchStride;
+
+    for (int y0 = me->firstRow; y0 <= me->lastRow; y0 += life->blockRows){
+        int y1 = y0 + life->blockRows - 1 < me->lastRow ? y0 + life->blockRows - 1 : me->lastRow;
+        int sr = y1 - y0 + 1 + 2 * d + 2;
+
+        for (int w0 = 1; w0 <= words; w0 += life->blockWords){
+            int w1 = w0 + life->blockWords - 1 < words ? w0 + life->blockWords - 1 : words;
+            int sw = w1 - w0 + 1 + 2 * haloWords + 2;
+            //scratch row i and word j hold grid row y0 - d - 1 + i and grid word w0 - haloWords - 1 + j
+            int gy = y0 - d - 1;
+            int gw = w0 - haloWords - 1;
+            uint64_t *a = me->scratch;
+            uint64_t *b = me->scratch + scratchWords;
+
+            //only the rows and words inside the grid are copied and calculated
+            int jlo = 1 - gw > 1 ? 1 - gw : 1;
+            int jhi = words - gw < sw - 2 ? words - gw : sw - 2;
+            int last = words - gw;
+
+            //copy the block and its halo into both scratch grids
+            for (int i = 0; i < sr; i++){
+                uint64_t *ra = a + (size_t) i * scratchStride;
+                uint64_t *rb = b + (size_t) i * scratchStride;
+                memset(ra, 0, sw * sizeof(uint64_t));
+                if (gy + i >= 1 && gy + i <= life->rows){
+                    int from = jlo - 1 > 0 ? jlo - 1 : 0;
+                    int to = jhi + 1 < last ? jhi + 1 : last;
+                    memcpy(ra + from, src + (size_t) (gy + i) * stride + gw + from, (to - from + 1) * sizeof(uint64_t));
+                }
+                memcpy(rb, ra, sw * sizeof(uint64_t));
+            }
+            for (int g = 0; g < d; g++){
+                //the rows still right after g generations
+                int ilo = g + 1 > 1 - gy ? g + 1 : 1 - gy;
+                int ihi = sr - 2 - g < life->rows - gy ? sr - 2 - g : life->rows - gy;
+
+                for (int i = ilo; i <= ihi; i++){
+                    const uint64_t *row = a + (size_t) i * scratchStride;
+                    uint64_t *next = b + (size_t) i * scratchStride;
+                    for (int j = jlo; j <= jhi; j++)
+                        next[j] = stepWord(row - scratchStride, row, row + scratchStride, j);
+                    //keep the columns past the edge of the grid dead
+                    if (last <= jhi)
+                        next[last] &= life->lastMask;
+                }
+                uint64_t *tmp = a;
+                a = b;
+                b = tmp;
+            }
+
+            for (int y = y0; y <= y1; y++)
+                memcpy(dst + (size_t) y * stride + w0, a + (size_t) (y - gy) * scratchStride + w0 - gw,
+                       (w1 - w0 + 1) * sizeof(uint64_t));
+        }
+    }
+}
+
+/**
+ * Recomputes the grid hash from the current grid.
+ *
+ * @param life the simulation
+ */
+static void hashGrid(Life *life)
+{
+    life->hash = 0;
+    for (int y = 1; y <= life->rows; y++)
+        for (int w = 1; w <= life->words; w++){
+            size_t i = (size_t) y * life->stride + w;
+            life->hash += life->currGrid[i] * wordWeight(i);
+        }
+}
+
+/**
+ * Run by thread 0 after each generation to look for a cycle.  A generation with no change at
+ * all is a cycle of period 1 straight away.  Otherwise, while the hash is kept, the hash is
+ * updated and when it matches one of the last HASH_HISTORY generations the grid is copied;
+ * when the grid is identical to the copy after that many generations the period is recorded.
+ *
+ * Also decides whether the step after the next one keeps the hash, by the hash windows.  The
+ * decision is one step ahead because the rest of the team reads it after the next barrier.
+ *
+ * @param life the simulation
+ * @return 1 if the grid is now known to be in a cycle
+ */
+static int trackCycle(Life *life)
+{
+    long long gen = life->currGen;
+    int prevOn = life->hashing[(gen - 1) & 1];
+    int currOn = life->hashing[gen & 1];
+    uint64_t hashDelta = 0;
+    int changed = 0;
+
+    for (int i = 0; i < life->numThreads; i++){
+        hashDelta += life->team[i].hashDelta[gen & 1];
+        changed |= life->team[i].changed[gen & 1];
+    }
+
+    //move on to the next window once this one is over
+    if (gen + 1 >= life->hashUntil){
+        life->hashFrom = life->hashUntil + life->hashGap;
+        life->hashUntil = life->hashFrom + HASH_WINDOW;
+        if (life->hashGap < HASH_GAP_MAX)
+            life->hashGap *= 2;
+    }
+    life->hashing[(gen + 1) & 1] = gen + 1 >= life->hashFrom;
+
+    if (!changed){
+        life->period = 1;
+        return 1;
+    }
+
+    //bring the hash up to the current grid, or start it over
+    if (prevOn)
+        life->hash += hashDelta;
+    else if (currOn){
+        hashGrid(life);
+        life->histLen = 0;
+        life->snapGen = -1;
+    }
+    life->hashValid = prevOn || currOn;
+    if (!life->hashValid){
+        life->histLen = 0;
+        life->snapGen = -1;
+        return 0;
+    }
+
+    //check the copy once its period has passed
+    if (life->snapGen >= 0 && gen == life->snapGen + life->snapPeriod){
+        size_t bytes = (size_t) life->trows * life->stride * sizeof(uint64_t);
+        if (life->hash == life->hashHist[life->snapGen % HASH_HISTORY]
+            && memcmp(life->currGrid, life->snapshot, bytes) == 0){
+            life->period = life->snapPeriod;
+            return 1;
+        }
+        life->snapGen = -1;
+    }
+
+    //look for the most recent generation with the same hash
+    if (life->snapGen < 0)
+        for (int k = 1; k <= life->histLen && k < HASH_HISTORY; k++)
+            if (life->hashHist[(gen - k) % HASH_HISTORY] == life->hash){
+                size_t bytes = (size_t) life->trows * life->stride * sizeof(uint64_t);
+                if (!life->snapshot){
+                    life->snapshot = (uint64_t *) malloc(bytes);
+                    if (!life->snapshot)
+                        exit(EXIT_FAILURE);
+                }
+                memcpy(life->snapshot, life->currGrid, bytes);
+                life->snapGen = gen;
+                life->snapPeriod = k;
+                break;
+            }
+
+    life->hashHist[gen % HASH_HISTORY] = life->hash;
+    if (life->histLen < HASH_HISTORY)
+        life->histLen++;
+    return 0;
+}
+
+/**
+ * Skips generations of a grid known to be in a cycle.  Without an observer whole periods
+ * are skipped at once.  With an observer every generation is still reported, but a still
+ * grid (period 1) needs no calculation and a period 2 grid only needs the buffers swapped,
+ * since the other buffer holds the grid of the generation before, which is also the grid of
+ * the generation after.  Longer periods with an observer are calculated as usual.
+ *
+ * @param life the simulation
+ * @param n    number of generations asked for
+ * @return number of generations still to calculate
+ */
+static long long fastForward(Life *life, long long n)
+{
+    //the hash is not kept while the period is known
+    life->hashValid = 0;
+    if (!life->observer){
+        life->currGen += n - n % life->period;
+        n %= life->period;
+    }
+    else if (life->period == 1){
+        for (; n > 0; n--){
+            life->currGen++;
+            life->observer(life, life->ctx);
+        }
+        return 0;
+    }
+    else if (life->period == 2){
+        for (long long z = 0; z < n; z++){
+            uint64_t *tmp = life->currGrid;
+            life->currGrid = life->nextGenGrid;
+            life->nextGenGrid = tmp;
+            life->currGen++;
+            life->observer(life, life->ctx);
+        }
+        n = 0;
+    }
+    else
+        return n;
+
+    //the tile generations no longer line up with the grids, so calculate every tile once
+    if (life->period > 1)
+        markAll(life);
+    return n;
+}
+
+/**
+ * Runs the generations asked for by the current life_step on the thread's band of rows.
+ * The team stops early, all after the same generation, when thread 0 finds a cycle; thread 0
+ * sets the stop flag of the next generation before reaching its barrier.
+ *
+ * @param me the thread's Worker
+ * @return number of generations run
+ */
+static long long runGenerations(Worker *me)
+{
+    Life *life = me->life;
+    uint64_t *src = life->currGrid;
+    uint64_t *dst = life->nextGenGrid;
+    long long gen = life->currGen;
+    long long pending = life->pending;
+    int detect = life->period == 0 && !life->noCycles;
+    int depth = life->observer ? 0 : life->blockDepth;
+    long long z = 0;
+
+    //temporal blocks, depth generations per barrier; nothing else lines up with them after
+    if (depth){
+        while (z < pending){
+            int d = pending - z < depth ? (int) (pending - z) : depth;
+            stepBlocks(me, src, dst, d);
+            pthread_barrier_wait(&life->barrier);
+            uint64_t *tmp = src;
+            src = dst;
+            dst = tmp;
+            z += d;
+        }
+        if (me->id == 0){
+            life->currGrid = src;
+            life->nextGenGrid = dst;
+            life->currGen = gen + z;
+            markAll(life);
+            life->hashValid = 0;
+            life->histLen = 0;
+            life->snapGen = -1;
+            restartWindows(life);
+        }
+        return z;
+    }
+
+    //nobody reads this flag before the first barrier
+    if (me->id == 0)
+        life->stop[(gen + 1) & 1] = 0;
+
+    while (z < pending){
+        stepBand(me, src, dst, gen, detect && life->hashing[gen & 1]);
+
+        //wait for every band of this generation, then swap buffers
+        pthread_barrier_wait(&life->barrier);
+        uint64_t *tmp = src;
+        src = dst;
+        dst = tmp;
+        gen++;
+        z++;
+        int stop = detect && life->stop[gen & 1];
+
+        if (me->id == 0){
+            life->currGrid = src;
+            life->nextGenGrid = dst;
+            life->currGen = gen;
+            if (detect && !stop)
+                life->stop[(gen + 1) & 1] = trackCycle(life);
+            if (life->observer)
+                life->observer(life, life->ctx);
+        }
+        if (stop)
+            break;
+    }
+    return z;
+}
+
+/**
+ * Pins the calling thread to one core.
+ *
+ * @param core index of the core
+ */
+static void pinThread(int core)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+/**
+ * Body of the team threads other than thread 0: waits for each life_step and runs its
+ * generations until the simulation is freed.
+ *
+ * @param param pointer to the thread's Worker
+ */
+static void *teamThread(void *param)
+{
+    Worker *me = (Worker *)param;
+    Life *life = me->life;
+
+    if (life->pin)
+        pinThread(me->id);
+
+    for (;;){
+        pthread_barrier_wait(&life->start);
+        if (life->quit)
+            break;
+        runGenerations(me);
+    }
+    return NULL;
+}
+
+Life *life_create(int rows, int cols, int numThreads, int pin)
+{
+    if (rows < 1 || cols < 1)
+        return NULL;
+
+    Life *life = (Life *) calloc(1, sizeof(Life));
+    if (!life)
+        exit(EXIT_FAILURE);
+
+    //set the total rows and the words per row creating the ghost perimeter (will be all zeros)
+    life->rows = rows;
+    life->cols = cols;
+    life->trows = rows + 2;
+    life->words = (cols + WORD_BITS - 1) / WORD_BITS;
+    life->stride = life->words + 2;
+    life->lastMask = (cols % WORD_BITS) ? ((uint64_t) 1 << (cols % WORD_BITS)) - 1 : ~(uint64_t) 0;
+
+    size_t gridWords = (size_t) life->trows * life->stride;
+    life->currGrid = (uint64_t *) calloc(gridWords, sizeof(uint64_t));
+    life->nextGenGrid = (uint64_t *) calloc(gridWords, sizeof(uint64_t));
+    if (!life->currGrid || !life->nextGenGrid)
+        exit(EXIT_FAILURE);
+
+    //the border tiles never change; every tile is calculated in the first generation
+    life->tileRows = (rows + TILE_ROWS - 1) / TILE_ROWS;
+    size_t tiles = (size_t) (life->tileRows + 2) * life->stride;
+    life->tileGen = (long long *) malloc(tiles * sizeof(long long));
+    if (!life->tileGen)
+        exit(EXIT_FAILURE);
+    for (size_t i = 0; i < tiles; i++)
+        life->tileGen[i] = -1;
+    markAll(life);
+    life->snapGen = -1;
+    life->hashValid = 1;
+    restartWindows(life);
+
+    //one thread per core by default, never more threads than rows
+    if (numThreads < 1){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = cores > 0 ? (int) cores : 1;
+    }
+    if (numThreads > rows)
+        numThreads = rows;
+    life->numThreads = numThreads;
+    life->pin = pin;
+
+    life->threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+    life->team = (Worker *) malloc(numThreads * sizeof(Worker));
+    if (!life->threads || !life->team)
+        exit(EXIT_FAILURE);
+    pthread_barrier_init(&life->start, NULL, numThreads);
+    pthread_barrier_init(&life->barrier, NULL, numThreads);
+
+    //split the rows into bands as evenly as possible
+    for (int i = 0; i < numThreads; i++){
+        life->team[i].life = life;
+        life->team[i].id = i;
+        life->team[i].firstRow = 1 + (int) ((long) rows * i / numThreads);
+        life->team[i].lastRow = (int) ((long) rows * (i + 1) / numThreads);
+        life->team[i].active = (unsigned char *) calloc(life->stride, 1);
+        life->team[i].diff = (uint64_t *) calloc(life->stride, sizeof(uint64_t));
+        life->team[i].scratch = NULL;
+        if (!life->team[i].active || !life->team[i].diff)
+            exit(EXIT_FAILURE);
+    }
+
+    if (pin)
+        pinThread(0);
+    for (int i = 1; i < numThreads; i++)
+        pthread_create(&life->threads[i], NULL, teamThread, &life->team[i]);
+    return life;
+}
+
+Life *life_create_hash(int rows, int cols, size_t memCap)
+{
+    if (rows < 1 || cols < 1)
+        return NULL;
+
+    Life *life = (Life *) calloc(1, sizeof(Life));
+    if (!life)
+        exit(EXIT_FAILURE);
+    life->rows = rows;
+    life->cols = cols;
+    life->hashLife = createHashLife(rows, cols, memCap);
+    return life;
+}
+
+Life *life_create_bytes(int rows, int cols)
+{
+    if (rows < 1 || cols < 1)
+        return NULL;
+
+    Life *life = (Life *) calloc(1, sizeof(Life));
+    if (!life)
+        exit(EXIT_FAILURE);
+    life->rows = rows;
+    life->cols = cols;
+    life->byteLife = createByteLife(rows, cols);
+    return life;
+}
+
+Life *life_create_procs(int rows, int cols, int numProcs, int pin)
+{
+    if (rows < 1 || cols < 1)
+        return NULL;
+
+    Life *life = (Life *) calloc(1, sizeof(Life));
+    if (!life)
+        exit(EXIT_FAILURE);
+    life->rows = rows;
+    life->cols = cols;
+    life->stripLife = createStripLife(rows, cols, numProcs, pin);
+    return life;
+}
+
+/**
+ * Returns 1 if the simulation is run by one of the other engines instead of the team.
+ */
+static int otherEngine(const Life *life)
+{
+    return life->hashLife || life->byteLife || life->stripLife;
+}
+
+void life_free(Life *life)
+{
+    if (otherEngine(life)){
+        if (life->hashLife)
+            freeHashLife(life->hashLife);
+        else if (life->byteLife)
+            freeByteLife(life->byteLife);
+        else
+            freeStripLife(life->stripLife);
+        free(life);
+        return;
+    }
+
+    //release the team from the start barrier with the quit flag set
+    life->quit = 1;
+    if (life->numThreads > 1)
+        pthread_barrier_wait(&life->start);
+    for (int i = 1; i < life->numThreads; i++)
+        pthread_join(life->threads[i], NULL);
+
+    pthread_barrier_destroy(&life->start);
+    pthread_barrier_destroy(&life->barrier);
+    for (int i = 0; i < life->numThreads; i++){
+        free(life->team[i].active);
+        free(life->team[i].diff);
+        free(life->team[i].scratch);
+    }
+    free(life->threads);
+    free(life->team);
+    free(life->tileGen);
+    free(life->snapshot);
+    free(life->currGrid);
+    free(life->nextGenGrid);
+    free(life);
+}
+
+int life_rows(const Life *life)
+{
+    return life->rows;
+}
+
+int life_cols(const Life *life)
+{
+    return life->cols;
+}
+
+long long life_generation(const Life *life)
+{
+    return life->currGen;
+}
+
+int life_get(const Life *life, int y, int x)
+{
+    if (life->hashLife)
+        return hashGet(life->hashLife, y, x);
+    if (life->byteLife)
+        return byteGet(life->byteLife, y, x);
+    if (life->stripLife)
+        return stripGet(life->stripLife, y, x);
+    uint64_t word = life->currGrid[(size_t) (y + 1) * life->stride + 1 + x / WORD_BITS];
+    return (int) ((word >> (x % WORD_BITS)) & 1);
+}
+
+void life_row(const Life *life, int y, unsigned char *cells)
+{
+    if (otherEngine(life)){
+        for (int x = 0; x < life->cols; x++)
+            cells[x] = (unsigned char) life_get(life, y, x);
+        return;
+    }
+
+    const uint64_t *row = life->currGrid + (size_t) (y + 1) * life->stride + 1;
+    for (int x = 0; x < life->cols; x++)
+        cells[x] = (row[x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+}
+
+void life_set(Life *life, int y, int x, int value)
+{
+    if (life->hashLife){
+        hashSet(life->hashLife, y, x, value);
+        return;
+    }
+    if (life->byteLife){
+        byteSet(life->byteLife, y, x, value);
+        return;
+    }
+    if (life->stripLife){
+        stripSet(life->stripLife, y, x, value);
+        return;
+    }
+
+    size_t i = (size_t) (y + 1) * life->stride + 1 + x / WORD_BITS;
+    uint64_t old = life->currGrid[i];
+    uint64_t bit = (uint64_t) 1 << (x % WORD_BITS);
+
+    if (value)
+        life->currGrid[i] |= bit;
+    else
+        life->currGrid[i] &= ~bit;
+
+    //the tile has to be calculated again and any cycle found is no longer valid
+    if (life->currGrid[i] != old){
+        life->hashValid = 0;
+        restartWindows(life);
+    }
+    *tileAt(life, y / TILE_ROWS, 1 + x / WORD_BITS) = life->currGen;
+    life->period = 0;
+    life->histLen = 0;
+    life->snapGen = -1;
+}
+
+int life_period(const Life *life)
+{
+    return life->period;
+}
+
+void life_cycles(Life *life, int on)
+{
+    if (otherEngine(life))
+        return;
+
+    //start over from no cycle and no hash either way
+    life->noCycles = !on;
+    life->period = 0;
+    life->hashValid = 0;
+    life->histLen = 0;
+    life->snapGen = -1;
+    restartWindows(life);
+}
+
+void life_temporal(Life *life, int depth, int blockRows, int blockWords)
+{
+    //the other engines have no team to block for
+    if (otherEngine(life))
+        return;
+
+    life->blockDepth = depth > 0 ? depth : 0;
+    life->blockRows = blockRows > 0 ? blockRows : BLOCK_ROWS;
+    life->blockWords = blockWords > 0 ? blockWords : BLOCK_WORDS;
+    if (!life->blockDepth)
+        return;
+
+    int haloWords = (life->blockDepth + WORD_BITS - 1) / WORD_BITS;
+    size_t scratchWords = (size_t) (life->blockRows + 2 * life->blockDepth + 2)
+                        * (life->blockWords + 2 * haloWords + 2);
+    for (int i = 0; i < life->numThreads; i++){
+        free(life->team[i].scratch);
+        life->team[i].scratch = (uint64_t *) malloc(2 * scratchWords * sizeof(uint64_t));
+        if (!life->team[i].scratch)
+            exit(EXIT_FAILURE);
+    }
+}
+
+void life_observe(Life *life, LifeObserver observer, void *ctx)
+{
+    life->observer = observer;
+    life->ctx = ctx;
+}
+
+void life_step(Life *life, long long n)
+{
+    //an observer has to see every generation, otherwise jump straight to the last one
+    if (life->hashLife){
+        if (life->observer)
+            for (; n > 0; n--){
+                hashStep(life->hashLife, 1);
+                life->currGen++;
+                life->observer(life, life->ctx);
+            }
+        else if (n > 0){
+            hashStep(life->hashLife, n);
+            life->currGen += n;
+        }
+        return;
+    }
+    if (life->stripLife){
+        if (life->observer)
+            for (; n > 0; n--){
+                stripStep(life->stripLife, 1);
+                life->currGen++;
+                life->observer(life, life->ctx);
+            }
+        else if (n > 0){
+            stripStep(life->stripLife, n);
+            life->currGen += n;
+        }
+        return;
+    }
+    if (life->byteLife){
+        for (; n > 0; n--){
+            byteStep(life->byteLife);
+            life->currGen++;
+            if (life->observer)
+                life->observer(life, life->ctx);
+        }
+        return;
+    }
+
+    while (n > 0){
+        if (life->period){
+            n = fastForward(life, n);
+            if (n == 0)
+                break;
+        }
+
+        //the first step can only carry on a hash that is up to date
+        if (!life->hashValid || life->period)
+            life->hashing[life->currGen & 1] = 0;
+
+        //wake the team and take part as thread 0
+        life->pending = n;
+        if (life->numThreads > 1)
+            pthread_barrier_wait(&life->start);
+        n -= runGenerations(&life->team[0]);
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ * @author David Hines (dhhines)
+ * @file lifeword.h
+ *
+ * Word kernel shared by the bit packed engines (lifelib.c and striplife.c): every row of
+ * the grid is stored as 64 cells per uint64_t word with a ghost word on each side.
+ */
+
+#ifndef LIFEWORD_H
+#define LIFEWORD_H
+
+#include <stdint.h>
+
+//number of cells held in each word of a row
+#define WORD_BITS 64
+
+/**
+ * Calculates the next generation of one word of a row.  Bit i of a word holds the cell in
+ * column i of that word, so the left neighbors of a word are the word shifted up by one with
+ * the top bit of the word before it carried in, and the right neighbors are the word shifted
+ * down with the low bit of the word after it carried in.
+ *
+ * The eight neighbor bits of every cell are added bit-parallel: the three cells above and
+ * the three below go through a full adder each and the two beside the cell through a half
+ * adder, giving three 1s bits and three 2s bits.  A final full adder combines the 1s bits
+ * into the 1s bit of the count plus one more 2s bit.  A cell is alive next generation when
+ * exactly one of the four 2s bits is set (count 2 or 3) and either the 1s bit is set
+ * (count 3) or the cell is alive now (count 2).
+ *
+ * @param above the row above
+ * @param row   the row to calculate
+ * @param below the row below
+ * @param w     the word to calculate (1 to words)
+ * @return the next generation of the word
+ */
+static inline uint64_t stepWord(const uint64_t *above, const uint64_t *row, const uint64_t *below, int w)
+{
+    //neighbors in the row above
+    uint64_t aL = (above[w] << 1) | (above[w - 1] >> 63);
+    uint64_t aR = (above[w] >> 1) | (above[w + 1] << 63);
+    uint64_t aM = above[w];
+    //neighbors in the same row
+    uint64_t bL = (row[w] << 1) | (row[w - 1] >> 63);
+    uint64_t bR = (row[w] >> 1) | (row[w + 1] << 63);
+    //neighbors in the row below
+    uint64_t cL = (below[w] << 1) | (below[w - 1] >> 63);
+    uint64_t cR = (below[w] >> 1) | (below[w + 1] << 63);
+    uint64_t cM = below[w];
+
+    //full adders for the rows above and below, half adder beside the cell
+    uint64_t s0 = aL ^ aM ^ aR;
+    uint64_t c0 = (aL & aM) | (aR & (aL ^ aM));
+    uint64_t s1 = cL ^ cM ^ cR;
+    uint64_t c1 = (cL & cM) | (cR & (cL ^ cM));
+    uint64_t s2 = bL ^ bR;
+    uint64_t c2 = bL & bR;
+
+    //combine the 1s bits
+    uint64_t ones = s0 ^ s1 ^ s2;
+    uint64_t c3 = (s0 & s1) | (s2 & (s0 ^ s1));
+
+    //exactly one of the four 2s bits set
+    uint64_t p = c0 ^ c1;
+    uint64_t q = c2 ^ c3;
+    uint64_t twos = (p ^ q) & ~((c0 & c1) | (c2 & c3));
+
+    return twos & (ones | row[w]);
+}
+
+#endif
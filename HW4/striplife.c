@@ -0,0 +1,363 @@
+/**
+ * @author David Hines (dhhines)
+ * @file striplife.c
+ *
+ * Implementation of the multi-process engine (see striplife.h).
+ *
+ * Every strip mapping starts with a small header of signals, then two mailboxes for the
+ * strip's first row and two for its last row, then the two grid buffers of the strip.  A
+ * strip buffer is bit packed like the grid in lifelib.c and has one ghost row above and
+ * below; before each generation the worker copies its neighbors' boundary rows into those
+ * ghost rows, and after it the worker posts its own new boundary rows and then its new
+ * generation number.  Mailboxes are kept per generation parity: a worker can be at most one
+ * generation ahead of a neighbor, since it waits for the neighbor's rows of the generation
+ * it is about to calculate, so a mailbox is never written while a neighbor still reads it.
+ *
+ * A signal is a futex word plus a count of waiting processes.  A waiter spins a little (only
+ * with more than one core), then registers itself and sleeps in FUTEX_WAIT until the word
+ * reaches the value it wants; the setter stores the word and only calls FUTEX_WAKE when
+ * someone is registered.  Both sides use sequentially consistent operations, so either the
+ * waiter sees the new value or the setter sees the waiter.
+ *
+ * The parent starts a life_step by setting the target generation and bumping the go signal,
+ * then waits for every strip's generation signal to reach the target.  The parent's waits
+ * time out every DEATH_CHECK_MS to check that no worker has died, since a dead worker's signal
+ * would never be set; the program then fails with a message instead of hanging.
+ */
+
+#include "striplife.h"
+#include "lifeword.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+
+//bytes in a cache line, used to keep signals apart
+#define CACHE_LINE 64
+//tries before a waiter sleeps, with more than one core
+#define SPIN_TRIES 2000
+//milliseconds between the parent's checks for dead workers while it waits
+#define DEATH_CHECK_MS 100
+
+//futex word and count of processes sleeping on it
+typedef struct Signal_Struct {
+    uint32_t value;
+    uint32_t waiters;
+}Signal;
+
+//header at the start of each strip mapping
+typedef struct Box_Struct {
+    Signal gen;  //generation of the strip, whose boundary rows are posted
+    char padGen[CACHE_LINE - sizeof(Signal)];
+    Signal ready;  //1 once the worker has touched the strip
+    char padReady[CACHE_LINE - sizeof(Signal)];
+}Box;
+
+//shared mapping the parent drives the workers with
+typedef struct Control_Struct {
+    Signal go;  //bumped for every life_step and to quit
+    char padGo[CACHE_LINE - sizeof(Signal)];
+    long long target;  //generation to run to
+    int quit;  //1 once the workers should exit
+}Control;
+
+//one strip and the views into its mapping
+typedef struct Strip_Struct {
+    Box *box;
+    size_t bytes;  //size of the mapping
+    uint64_t *top[2];  //mailboxes for the first row, by generation parity
+    uint64_t *bottom[2];  //mailboxes for the last row, by generation parity
+    uint64_t *grid[2];  //(numRows + 2) x stride words, by generation parity
+    int firstRow;  //first row of the grid in the strip (0 based)
+    int numRows;
+    pid_t pid;
+}Strip;
+
+struct StripLife_Struct {
+    int rows;  //number of rows in grid
+    int cols;  //number of columns in grid
+    int words;  //number of words holding the cells of a row
+    int stride;  //number of words in a row including the two ghost words
+    uint64_t lastMask;  //bits of the last word of a row that are inside the grid
+    int numProcs;
+    int pin;  //1 to pin each worker to its own core
+    int spin;  //tries before sleeping on a signal
+    long long currGen;  //generation of the grid
+    int *stripOf;  //strip of each row
+    Control *control;
+    Strip *strips;
+};
+
+/**
+ * Waits until a signal reaches a value (compared as a wrapping 32 bit count).
+ *
+ * @param s       the signal
+ * @param want    the value
+ * @param spin    tries before sleeping
+ * @param timeout longest time to sleep at a time, or NULL to wait for as long as it takes
+ * @return 0 once the value is reached, -1 if a sleep timed out first
+ */
+static int signalWait(Signal *s, uint32_t want, int spin, const struct timespec *timeout)
+{
+    for (int i = 0; i < spin; i++){
+        if ((int32_t) (__atomic_load_n(&s->value, __ATOMIC_ACQUIRE) - want) >= 0)
+            return 0;
+        __builtin_ia32_pause();
+    }
+
+    int status = 0;
+    __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    for (;;){
+        uint32_t value = __atomic_load_n(&s->value, __ATOMIC_SEQ_CST);
+        if ((int32_t) (value - want) >= 0)
+            break;
+        if (syscall(SYS_futex, &s->value, FUTEX_WAIT, value, timeout, NULL, 0) < 0
+                && errno == ETIMEDOUT){
+            status = -1;
+            break;
+        }
+    }
+    __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    return status;
+}
+
+/**
+ * Waits in the parent until a signal of the workers reaches a value, checking for dead
+ * workers every DEATH_CHECK_MS.  Exits the program if a worker has died.
+ *
+ * @param sl   the grid
+ * @param s    the signal
+ * @param want the value
+ */
+static void parentWait(StripLife *sl, Signal *s, uint32_t want)
+{
+    struct timespec check = { 0, DEATH_CHECK_MS * 1000000L };
+
+    while (signalWait(s, want, sl->spin, &check) < 0){
+        for (int i = 0; i < sl->numProcs; i++){
+            int status;
+            if (waitpid(sl->strips[i].pid, &status, WNOHANG) != sl->strips[i].pid)
+                continue;
+            if (WIFSIGNALED(status))
+                fprintf(stderr, "Strip worker %d (PID %d) killed by signal %d\n",
+                        i, (int) sl->strips[i].pid, WTERMSIG(status));
+            else
+                fprintf(stderr, "Strip worker %d (PID %d) exited\n", i, (int) sl->strips[i].pid);
+            //the other workers are killed as the parent exits (PR_SET_PDEATHSIG)
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * Sets a signal and wakes the processes waiting on it.
+ *
+ * @param s     the signal
+ * @param value the new value
+ */
+static void signalSet(Signal *s, uint32_t value)
+{
+    __atomic_store_n(&s->value, value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &s->value, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/**
+ * Body of a worker process: touches its strip, then runs the generations of every
+ * life_step until told to quit.  Never returns.
+ *
+ * @param sl the grid (the worker's copy of the parent's)
+ * @param id index of the worker's strip
+ */
+static void runWorker(StripLife *sl, int id)
+{
+    Strip *me = &sl->strips[id];
+    Strip *up = id > 0 ? &sl->strips[id - 1] : NULL;
+    Strip *down = id < sl->numProcs - 1 ? &sl->strips[id + 1] : NULL;
+    int stride = sl->stride;
+    int h = me->numRows;
+    size_t rowBytes = stride * sizeof(uint64_t);
+
+    //exit with the parent
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (sl->pin){
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(id % CPU_SETSIZE, &cpus);
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    //first touch puts the strip's pages on this worker's node
+    memset(me->box + 1, 0, me->bytes - sizeof(Box));
+    signalSet(&me->box->ready, 1);
+
+    long long gen = 0;
+    uint32_t seen = 0;
+    for (;;){
+        signalWait(&sl->control->go, ++seen, sl->spin, NULL);
+        if (sl->control->quit)
+            _exit(EXIT_SUCCESS);
+
+        for (long long target = sl->control->target; gen < target; gen++){
+            int cur = gen & 1;
+            uint64_t *src = me->grid[cur];
+            uint64_t *dst = me->grid[!cur];
+
+            //ghost rows from the neighbors' boundary rows of this generation
+            if (up){
+                signalWait(&up->box->gen, (uint32_t) gen, sl->spin, NULL);
+                memcpy(src, up->bottom[cur], rowBytes);
+            }
+            if (down){
+                signalWait(&down->box->gen, (uint32_t) gen, sl->spin, NULL);
+                memcpy(src + (size_t) (h + 1) * stride, down->top[cur], rowBytes);
+            }
+
+            for (int y = 1; y <= h; y++){
+                const uint64_t *row = src + (size_t) y * stride;
+                uint64_t *next = dst + (size_t) y * stride;
+                for (int w = 1; w <= sl->words; w++)
+                    next[w] = stepWord(row - stride, row, row + stride, w);
+                //keep the columns past the edge of the grid dead
+                next[sl->words] &= sl->lastMask;
+            }
+
+            //post the new boundary rows, then the new generation
+            memcpy(me->top[!cur], dst + stride, rowBytes);
+            memcpy(me->bottom[!cur], dst + (size_t) h * stride, rowBytes);
+            signalSet(&me->box->gen, (uint32_t) (gen + 1));
+        }
+    }
+}
+
+StripLife *createStripLife(int rows, int cols, int numProcs, int pin)
+{
+    StripLife *sl = (StripLife *) calloc(1, sizeof(StripLife));
+    if (!sl)
+        exit(EXIT_FAILURE);
+
+    sl->rows = rows;
+    sl->cols = cols;
+    sl->words = (cols + WORD_BITS - 1) / WORD_BITS;
+    sl->stride = sl->words + 2;
+    sl->lastMask = (cols % WORD_BITS) ? ((uint64_t) 1 << (cols % WORD_BITS)) - 1 : ~(uint64_t) 0;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numProcs < 1)
+        numProcs = cores > 0 ? (int) cores : 1;
+    if (numProcs > rows)
+        numProcs = rows;
+    sl->numProcs = numProcs;
+    sl->pin = pin;
+    sl->spin = cores > 1 ? SPIN_TRIES : 0;
+
+    sl->control = mmap(NULL, sizeof(Control), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    sl->strips = (Strip *) calloc(numProcs, sizeof(Strip));
+    sl->stripOf = (int *) malloc(rows * sizeof(int));
+    if (sl->control == MAP_FAILED || !sl->strips || !sl->stripOf){
+        perror("createStripLife");
+        exit(EXIT_FAILURE);
+    }
+
+    //split the rows as evenly as possible; the mappings are only touched by their workers
+    for (int i = 0; i < numProcs; i++){
+        Strip *s = &sl->strips[i];
+        s->firstRow = (int) ((long) rows * i / numProcs);
+        s->numRows = (int) ((long) rows * (i + 1) / numProcs) - s->firstRow;
+        for (int y = s->firstRow; y < s->firstRow + s->numRows; y++)
+            sl->stripOf[y] = i;
+
+        size_t gridWords = (size_t) (s->numRows + 2) * sl->stride;
+        s->bytes = sizeof(Box) + (4 * (size_t) sl->stride + 2 * gridWords) * sizeof(uint64_t);
+        s->box = mmap(NULL, s->bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (s->box == MAP_FAILED){
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+        uint64_t *words = (uint64_t *) (s->box + 1);
+        s->top[0] = words;
+        s->top[1] = words + sl->stride;
+        s->bottom[0] = words + 2 * sl->stride;
+        s->bottom[1] = words + 3 * sl->stride;
+        s->grid[0] = words + 4 * sl->stride;
+        s->grid[1] = s->grid[0] + gridWords;
+    }
+
+    //flush so the workers don't inherit anything still to be written
+    fflush(NULL);
+    for (int i = 0; i < numProcs; i++){
+        sl->strips[i].pid = fork();
+        if (sl->strips[i].pid < 0){
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (sl->strips[i].pid == 0)
+            runWorker(sl, i);
+    }
+    for (int i = 0; i < numProcs; i++)
+        parentWait(sl, &sl->strips[i].box->ready, 1);
+    return sl;
+}
+
+void freeStripLife(StripLife *sl)
+{
+    sl->control->quit = 1;
+    signalSet(&sl->control->go, sl->control->go.value + 1);
+    for (int i = 0; i < sl->numProcs; i++){
+        waitpid(sl->strips[i].pid, NULL, 0);
+        munmap(sl->strips[i].box, sl->strips[i].bytes);
+    }
+    munmap(sl->control, sizeof(Control));
+    free(sl->strips);
+    free(sl->stripOf);
+    free(sl);
+}
+
+int stripGet(const StripLife *sl, int y, int x)
+{
+    const Strip *s = &sl->strips[sl->stripOf[y]];
+    uint64_t word = s->grid[sl->currGen & 1][(size_t) (y - s->firstRow + 1) * sl->stride + 1 + x / WORD_BITS];
+    return (int) ((word >> (x % WORD_BITS)) & 1);
+}
+
+void stripSet(StripLife *sl, int y, int x, int value)
+{
+    Strip *s = &sl->strips[sl->stripOf[y]];
+    int cur = sl->currGen & 1;
+    int r = y - s->firstRow + 1;
+    uint64_t *word = &s->grid[cur][(size_t) r * sl->stride + 1 + x / WORD_BITS];
+    uint64_t bit = (uint64_t) 1 << (x % WORD_BITS);
+
+    if (value)
+        *word |= bit;
+    else
+        *word &= ~bit;
+
+    //the neighbors read the boundary rows from the mailboxes
+    if (r == 1)
+        s->top[cur][1 + x / WORD_BITS] = *word;
+    if (r == s->numRows)
+        s->bottom[cur][1 + x / WORD_BITS] = *word;
+}
+
+void stripStep(StripLife *sl, long long n)
+{
+    if (n <= 0)
+        return;
+
+    sl->currGen += n;
+    sl->control->target = sl->currGen;
+    signalSet(&sl->control->go, sl->control->go.value + 1);
+    for (int i = 0; i < sl->numProcs; i++)
+        parentWait(sl, &sl->strips[i].box->gen, (uint32_t) sl->currGen);
+}
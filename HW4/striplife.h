@@ -0,0 +1,68 @@
+/**
+ * @author David Hines (dhhines)
+ * @file striplife.h
+ *
+ * Multi-process engine for the life library (see life.h, life_create_procs).  The grid is
+ * split into horizontal strips, one per forked worker process.  Every strip lives in its own
+ * shared mapping that its worker touches first (after pinning itself, if asked), so on a
+ * NUMA machine its pages end up on the worker's node.  Each generation the workers only
+ * exchange the first and last row of their strips, through mailboxes in the strip mappings,
+ * and wait for their neighbors with futexes.
+ *
+ * The cells outside the grid are always dead, like in the other engines, so all of them give
+ * the same grids.
+ */
+
+#ifndef STRIPLIFE_H
+#define STRIPLIFE_H
+
+typedef struct StripLife_Struct StripLife;
+
+/**
+ * Creates an empty (all dead) grid and forks its worker processes.  Returns once every
+ * worker has touched its strip.
+ *
+ * @param rows     number of rows in the grid
+ * @param cols     number of columns in the grid
+ * @param numProcs number of worker processes (0 for one per core), never more than rows
+ * @param pin      1 to pin each worker to its own core
+ * @return the new grid
+ */
+StripLife *createStripLife(int rows, int cols, int numProcs, int pin);
+
+/**
+ * Stops the workers and frees the grid.
+ *
+ * @param sl the grid
+ */
+void freeStripLife(StripLife *sl);
+
+/**
+ * Returns the value of a cell (0 based row and column).  Only call between steps.
+ *
+ * @param sl the grid
+ * @param y  row of the cell
+ * @param x  column of the cell
+ * @return 1 if the cell is alive, 0 otherwise
+ */
+int stripGet(const StripLife *sl, int y, int x);
+
+/**
+ * Sets the value of a cell (0 based row and column).  Only call between steps.
+ *
+ * @param sl    the grid
+ * @param y     row of the cell
+ * @param x     column of the cell
+ * @param value 1 for alive, 0 for dead
+ */
+void stripSet(StripLife *sl, int y, int x, int value);
+
+/**
+ * Runs generations and waits for every worker to finish them.
+ *
+ * @param sl the grid
+ * @param n  number of generations
+ */
+void stripStep(StripLife *sl, long long n);
+
+#endif
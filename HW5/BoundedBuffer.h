@@ -0,0 +1,236 @@
+/**
+ * @author David Hines
+ * @file BoundedBuffer.h
+ *
+ * The bounded buffer monitor of ProducerConsumer.cpp as a reusable template: a circular
+ * buffer guarded by a mutex, with one condition variable for producers waiting on a full
+ * buffer and one for consumers waiting on an empty one.
+ *
+ * Besides single item put and get, putMany and getMany move a run of items per critical
+ * section, copied with at most two memcpy calls (the run can wrap around the end of the
+ * buffer).  Waiters are only woken on the transitions they wait for: a put that makes an
+ * empty buffer non-empty and a get that makes a full buffer non-full.  Those wake every
+ * waiter of the other side, since one run can satisfy several of them and a waiter that is
+ * not woken on its transition would never be woken at all.
+ *
+ * Items have to be trivially copyable, since they are moved with memcpy.
+ *
+ * Once Metrics::start was called, every put and get is counted in the calling thread's
+ * metrics (Metrics.h), with its waits on a full or empty buffer and its spurious wakeups, and
+ * each item's time from put to get and each critical section's lock hold time go into its
+ * histograms.  Items are stamped in a second array next to the buffer, so any item type can
+ * be timed.  Nothing is printed while the mutex is held.
+ */
+
+#ifndef BOUNDEDBUFFER_H
+#define BOUNDEDBUFFER_H
+
+#include "Metrics.h"
+#include <pthread.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+template <typename T>
+class BoundedBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "items are copied with memcpy");
+
+public:
+    /**
+     * Creates an empty buffer.
+     *
+     * @param capacity most items the buffer holds
+     */
+    explicit BoundedBuffer(size_t capacity)
+        : buf(static_cast<T *>(malloc(capacity * sizeof(T)))),
+          stamps(static_cast<uint64_t *>(calloc(capacity, sizeof(uint64_t)))), maxBuf(capacity),
+          cnt(0), in(0), out(0)
+    {
+        if (!buf || !stamps)
+            exit(EXIT_FAILURE);
+        pthread_mutex_init(&m1, NULL);
+        pthread_cond_init(&empty, NULL);
+        pthread_cond_init(&full, NULL);
+    }
+
+    ~BoundedBuffer()
+    {
+        pthread_mutex_destroy(&m1);
+        pthread_cond_destroy(&empty);
+        pthread_cond_destroy(&full);
+        free(buf);
+        free(stamps);
+    }
+
+    BoundedBuffer(const BoundedBuffer &) = delete;
+    BoundedBuffer &operator=(const BoundedBuffer &) = delete;
+
+    /**
+     * Adds an item, waiting while the buffer is full.
+     *
+     * @param item the item
+     */
+    void put(const T &item)
+    {
+        putMany(&item, 1);
+    }
+
+    /**
+     * Removes the oldest item, waiting while the buffer is empty.
+     *
+     * @return the item
+     */
+    T get()
+    {
+        T item;
+        getMany(&item, 1);
+        return item;
+    }
+
+    /**
+     * Adds a run of items in order, waiting whenever the buffer is full.  Each critical
+     * section moves as many of them as there is room for.  Runs of different producers can
+     * be interleaved.
+     *
+     * @param items the items
+     * @param n     number of items
+     */
+    void putMany(const T *items, size_t n)
+    {
+        ThreadMetrics *metrics = Metrics::enabled() ? &Metrics::local() : NULL;
+        if (metrics)
+            bump(metrics->puts, n);
+
+        pthread_mutex_lock(&m1);
+        uint64_t held = metrics ? Metrics::now() : 0;
+        while (n > 0){
+            if (cnt == maxBuf)
+                held = waitWhile(full, maxBuf, metrics, held);
+
+            size_t run = n < maxBuf - cnt ? n : maxBuf - cnt;
+            copyIn(items, run, metrics ? held : 0);
+            bool wasEmpty = cnt == 0;
+            cnt += run;
+            items += run;
+            n -= run;
+
+            if (wasEmpty)
+                pthread_cond_broadcast(&empty);
+        }
+        if (metrics)
+            metrics->lockHold.record(Metrics::now() - held);
+        pthread_mutex_unlock(&m1);
+    }
+
+    /**
+     * Removes up to max of the oldest items, waiting while the buffer is empty.
+     *
+     * @param items where to store the items
+     * @param max   most items to remove (at least 1)
+     * @return number of items removed
+     */
+    size_t getMany(T *items, size_t max)
+    {
+        ThreadMetrics *metrics = Metrics::enabled() ? &Metrics::local() : NULL;
+
+        pthread_mutex_lock(&m1);
+        uint64_t held = metrics ? Metrics::now() : 0;
+        if (cnt == 0)
+            held = waitWhile(empty, 0, metrics, held);
+
+        size_t run = max < cnt ? max : cnt;
+        copyOut(items, run, metrics);
+        bool wasFull = cnt == maxBuf;
+        cnt -= run;
+
+        if (wasFull)
+            pthread_cond_broadcast(&full);
+        if (metrics)
+            metrics->lockHold.record(Metrics::now() - held);
+        pthread_mutex_unlock(&m1);
+
+        if (metrics)
+            bump(metrics->gets, run);
+        return run;
+    }
+
+    size_t capacity() const { return maxBuf; }
+
+private:
+    /**
+     * Waits on a condition variable while the count stays at a value (full or empty).  Hold
+     * the mutex.  With metrics, counts the wait and its spurious wakeups and records the lock
+     * hold time up to the wait.
+     *
+     * @param cond    the condition variable
+     * @param value   the count to wait out
+     * @param metrics the caller's metrics, or NULL
+     * @param held    when the caller got the mutex
+     * @return when the caller got the mutex back
+     */
+    uint64_t waitWhile(pthread_cond_t &cond, size_t value, ThreadMetrics *metrics, uint64_t held)
+    {
+        if (metrics){
+            bump(value == 0 ? metrics->emptyWaits : metrics->fullWaits);
+            metrics->lockHold.record(Metrics::now() - held);
+        }
+        pthread_cond_wait(&cond, &m1);
+        while (cnt == value){
+            if (metrics)
+                bump(metrics->spuriousWakeups);
+            pthread_cond_wait(&cond, &m1);
+        }
+        return metrics ? Metrics::now() : 0;
+    }
+
+    /**
+     * Copies items into the free slots at in, wrapping around the end.  Hold the mutex.
+     *
+     * @param stamp time of the put, or 0 when not timed
+     */
+    void copyIn(const T *items, size_t n, uint64_t stamp)
+    {
+        size_t first = n < maxBuf - in ? n : maxBuf - in;
+        memcpy(buf + in, items, first * sizeof(T));
+        memcpy(buf, items + first, (n - first) * sizeof(T));
+        if (stamp)
+            for (size_t i = 0; i < n; i++)
+                stamps[(in + i) % maxBuf] = stamp;
+        in = (in + n) % maxBuf;
+    }
+
+    /**
+     * Copies items out of the full slots at out, wrapping around the end.  Hold the mutex.
+     *
+     * @param metrics where to record the items' latency, or NULL
+     */
+    void copyOut(T *items, size_t n, ThreadMetrics *metrics)
+    {
+        size_t first = n < maxBuf - out ? n : maxBuf - out;
+        memcpy(items, buf + out, first * sizeof(T));
+        memcpy(items + first, buf, (n - first) * sizeof(T));
+        if (metrics){
+            uint64_t now = Metrics::now();
+            for (size_t i = 0; i < n; i++){
+                //items put before metrics were started have no stamp
+                uint64_t stamp = stamps[(out + i) % maxBuf];
+                if (stamp)
+                    metrics->latency.record(now - stamp);
+            }
+        }
+        out = (out + n) % maxBuf;
+    }
+
+    pthread_mutex_t m1;
+    pthread_cond_t empty;  //consumers wait here while the buffer is empty
+    pthread_cond_t full;  //producers wait here while the buffer is full
+    T *buf;
+    uint64_t *stamps;  //time of the put of each item, 0 if not timed
+    size_t maxBuf;
+    size_t cnt;
+    size_t in;
+    size_t out;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * @author David Hines
+ * @file Futex.h
+ *
+ * Thin wrapper around the Linux futex system call, and an event count built on it that lets
+ * a thread sleep until some condition it polls (like "the ring is not empty") may have
+ * changed, without any mutex.
+ *
+ * A waiter registers itself with prepareWait, which also returns the current key, checks its
+ * condition once more and then either calls cancelWait (the condition already holds) or
+ * commitWait with the key.  A notifier first makes its change visible and then calls notify,
+ * which costs a fence and a load of the sleeper count while nobody waits, and only bumps the
+ * key and makes the wake system call when a waiter is registered.  Both sides
+ * put a full fence between their write and their read, so either the waiter sees the change
+ * when it checks again, or the notifier sees the waiter; and a waiter that read the key
+ * before the bump sleeps on a stale key (FUTEX_WAIT then returns at once).
+ */
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be 32 bits");
+
+/**
+ * Sleeps while a futex word still holds a value.  Can return spuriously.
+ *
+ * @param word  the futex word
+ * @param value the value the caller saw
+ */
+inline void futexWait(std::atomic<uint32_t> *word, uint32_t value)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT_PRIVATE, value,
+            nullptr, nullptr, 0);
+}
+
+/**
+ * Wakes threads sleeping on a futex word.
+ *
+ * @param word  the futex word
+ * @param count most threads to wake (INT_MAX for all)
+ */
+inline void futexWake(std::atomic<uint32_t> *word, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE_PRIVATE, count,
+            nullptr, nullptr, 0);
+}
+
+/**
+ * Event count: a futex key bumped by every notify that finds a sleeper, plus a count of the
+ * waiters registered on the key.  Like PhaseWord's, the count is never cleared by the
+ * notifier: with several waiters one of them can register just before a notify and read the
+ * bumped key just after it, lose the race for the item to another waiter and go to sleep on
+ * the new key, and a cleared flag would then leave it asleep with nobody to wake it.  Each
+ * waiter takes itself off once it is done waiting.  It takes a cache line of its own, apart
+ * from whatever the owner puts next to it.
+ */
+class EventCount {
+public:
+    EventCount() : key(0), sleepers(0) {}
+
+    /**
+     * Registers the caller as a waiter.
+     *
+     * @return the key to pass to commitWait
+     */
+    uint32_t prepareWait()
+    {
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return key.load();
+    }
+
+    /**
+     * Unregisters a waiter whose condition held after all.
+     */
+    void cancelWait()
+    {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sleeps until a notify after prepareWait, then unregisters the caller.  Can return
+     * spuriously, so the caller checks its condition again (registering again first).
+     *
+     * @param prepared the key returned by prepareWait
+     */
+    void commitWait(uint32_t prepared)
+    {
+        if (key.load() == prepared)
+            futexWait(&key, prepared);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sleeps until an attempt succeeds, checking it again after every wakeup.
+     *
+     * @param attempt tries the operation, true once it is done
+     */
+    template <typename Attempt>
+    void waitUntil(Attempt attempt)
+    {
+        for (;;){
+            uint32_t prepared = prepareWait();
+            if (attempt()){
+                cancelWait();
+                return;
+            }
+            commitWait(prepared);
+        }
+    }
+
+    /**
+     * Wakes every registered waiter.  Costs no system call when there are none.
+     */
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) != 0){
+            key.fetch_add(1);
+            futexWake(&key, INT_MAX);
+        }
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> key;
+    std::atomic<uint32_t> sleepers;
+};
+
+/**
+ * Futex word that only counts up (a phase or an episode count), plus a count of the waiters
+ * that may be asleep on it: whoever moves the word on only makes the wake system call when the
+ * count isn't 0.  The count is never cleared by the waker, since the same word is waited on
+ * again right away: a waiter let go by one advance can already be on its way to sleep for the
+ * next, and clearing a flag then would leave it asleep with nobody to wake it.  Each waiter
+ * takes itself off when it wakes.  It takes a cache line of its own.
+ */
+class PhaseWord {
+public:
+    PhaseWord() : value(0), sleepers(0) {}
+
+    /**
+     * Returns the current value (acquire).
+     */
+    uint32_t load() const
+    {
+        return value.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Waits until the value is no longer old: spins, then sleeps.
+     *
+     * @param old   the value to wait out
+     * @param spin  tries before sleeping
+     */
+    void awaitChange(uint32_t old, int spin)
+    {
+        for (int i = 0; i < spin; i++){
+            if (value.load(std::memory_order_acquire) != old)
+                return;
+            __builtin_ia32_pause();
+        }
+        if (value.load(std::memory_order_acquire) != old)
+            return;
+        //counted before the last check, so either the check sees the advance or the
+        //advance sees the count
+        sleepers.fetch_add(1);
+        while (value.load() == old)
+            futexWait(&value, old);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Moves the value on by one (release) and wakes every waiter.
+     */
+    void advance()
+    {
+        value.fetch_add(1);
+        if (sleepers.load() != 0)
+            futexWake(&value, INT_MAX);
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> value;
+    std::atomic<uint32_t> sleepers;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @author David Hines
+ * @file MessagePool.h
+ *
+ * Pool of fixed size message slots for zero copy handoff through a queue.  A producer
+ * acquires a slot, writes its message in place and puts the slot's index through the queue;
+ * the consumer reads the message where it is and releases the slot.  Only the 4 byte index
+ * goes through the queue, however large the messages are.
+ *
+ * The slots are carved out of one slab, allocated and touched once when the pool is created,
+ * with every slot starting on a cache line so neighboring messages don't share lines.  The
+ * free slots are kept in an MpmcQueue of indexes as large as the pool, so acquire and release
+ * are lock-free and never allocate, release never waits (the free list always has room), and
+ * acquire on an exhausted pool sleeps until a consumer releases a slot: producers can never
+ * get more than the pool's worth of messages ahead of the consumers.
+ */
+
+#ifndef MESSAGEPOOL_H
+#define MESSAGEPOOL_H
+
+#include "MpmcQueue.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+class MessagePool {
+public:
+    /**
+     * Creates a pool with every slot free.
+     *
+     * @param slots    number of slots
+     * @param slotSize bytes per message
+     */
+    MessagePool(uint32_t slots, size_t slotSize)
+        : numSlots(slots), stride((slotSize + 63) / 64 * 64), freeSlots(slots)
+    {
+        void *mem;
+        if (posix_memalign(&mem, 64, (size_t) slots * stride) != 0){
+            perror("posix_memalign");
+            exit(EXIT_FAILURE);
+        }
+        slab = static_cast<char *>(mem);
+        //fault the slab in now rather than on the first lap of messages
+        memset(slab, 0, (size_t) slots * stride);
+        for (uint32_t i = 0; i < slots; i++)
+            freeSlots.put(i);
+    }
+
+    ~MessagePool()
+    {
+        free(slab);
+    }
+
+    MessagePool(const MessagePool &) = delete;
+    MessagePool &operator=(const MessagePool &) = delete;
+
+    /**
+     * Takes a free slot, waiting while there is none.
+     *
+     * @return index of the slot
+     */
+    uint32_t acquire()
+    {
+        uint32_t slot;
+        freeSlots.get(slot);
+        return slot;
+    }
+
+    /**
+     * Takes a free slot unless there is none.
+     *
+     * @param slot where to store the index of the slot
+     * @return true if a slot was taken
+     */
+    bool tryAcquire(uint32_t &slot)
+    {
+        return freeSlots.tryGet(slot);
+    }
+
+    /**
+     * Gives a slot back to the pool.
+     *
+     * @param slot index of the slot
+     */
+    void release(uint32_t slot)
+    {
+        freeSlots.put(slot);
+    }
+
+    /**
+     * Returns the message memory of a slot.
+     *
+     * @param slot index of the slot
+     */
+    char *data(uint32_t slot)
+    {
+        return slab + (size_t) slot * stride;
+    }
+
+    uint32_t slots() const { return numSlots; }
+
+private:
+    char *slab;
+    uint32_t numSlots;
+    size_t stride;  //bytes between slots, a whole number of cache lines
+    MpmcQueue<uint32_t> freeSlots;
+};
+
+#endif
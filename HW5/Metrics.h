@@ -0,0 +1,321 @@
+/**
+ * @author David Hines
+ * @file Metrics.h
+ *
+ * Low overhead metrics for the queues: per-thread counters (puts, gets, waits on a full or
+ * empty buffer, spurious wakeups) and log-linear histograms (like HDR histograms, 16 buckets
+ * per power of two, so within about 6%) of enqueue to dequeue latency and lock hold time, in
+ * nanoseconds.
+ *
+ * Every thread records into its own ThreadMetrics, registered the first time the thread uses
+ * it (the only time a lock is taken); recording is a plain load and store of the thread's own
+ * relaxed atomics, so it never waits and never bounces a cache line.  A dump adds up every
+ * thread's numbers with relaxed loads while they keep running, so it is a snapshot that can
+ * be a few events behind.  ThreadMetrics are never freed, so a dump still counts threads that
+ * have exited.
+ *
+ * Nothing is recorded until Metrics::start, which also prints a dump at exit and starts a
+ * thread that prints one whenever the process gets SIGUSR1.  Call it before creating any
+ * other thread, since it blocks SIGUSR1 in the calling thread for the new threads to inherit.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+/**
+ * Adds to a counter only its owner thread writes.
+ */
+inline void bump(std::atomic<uint64_t> &counter, uint64_t n = 1)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class Histogram {
+public:
+    //16 exact buckets below 16, then 16 per power of two up to 2^64
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKETS = 61 * SUB_BUCKETS;
+
+    Histogram()
+    {
+        for (int i = 0; i < BUCKETS; i++)
+            counts[i].store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records a value.  Only call from the owner thread.
+     *
+     * @param value the value
+     */
+    void record(uint64_t value)
+    {
+        bump(counts[bucketOf(value)]);
+        if (value > max.load(std::memory_order_relaxed))
+            max.store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds the counts to a total.
+     *
+     * @param totals BUCKETS counts to add to
+     * @param most   largest value so far, updated
+     */
+    void addTo(uint64_t *totals, uint64_t &most) const
+    {
+        for (int i = 0; i < BUCKETS; i++)
+            totals[i] += counts[i].load(std::memory_order_relaxed);
+        uint64_t m = max.load(std::memory_order_relaxed);
+        if (m > most)
+            most = m;
+    }
+
+    /**
+     * Returns the bucket of a value.
+     */
+    static int bucketOf(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return (int) value;
+        int e = 63 - __builtin_clzll(value);
+        return (e - 3) * SUB_BUCKETS + (int) ((value >> (e - 4)) & (SUB_BUCKETS - 1));
+    }
+
+    /**
+     * Returns the largest value that goes into a bucket.
+     */
+    static uint64_t bucketHigh(int bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        int e = bucket / SUB_BUCKETS + 3;
+        uint64_t low = (uint64_t) (SUB_BUCKETS + bucket % SUB_BUCKETS) << (e - 4);
+        return low + ((uint64_t) 1 << (e - 4)) - 1;
+    }
+
+    /**
+     * Returns the value at a percentile of added up counts.
+     *
+     * @param totals  BUCKETS counts
+     * @param total   sum of the counts
+     * @param percent the percentile (0 to 100)
+     * @param most    largest value, returned for the top percentile
+     */
+    static uint64_t percentile(const uint64_t *totals, uint64_t total, double percent, uint64_t most)
+    {
+        uint64_t rank = (uint64_t) (total * percent / 100);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++){
+            seen += totals[i];
+            if (seen > rank)
+                return bucketHigh(i) < most ? bucketHigh(i) : most;
+        }
+        return most;
+    }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> max;
+};
+
+//the numbers of one thread
+struct ThreadMetrics {
+    ThreadMetrics()
+    {
+        puts.store(0, std::memory_order_relaxed);
+        gets.store(0, std::memory_order_relaxed);
+        fullWaits.store(0, std::memory_order_relaxed);
+        emptyWaits.store(0, std::memory_order_relaxed);
+        spuriousWakeups.store(0, std::memory_order_relaxed);
+    }
+
+    int id;  //registration order
+    std::atomic<uint64_t> puts;
+    std::atomic<uint64_t> gets;
+    std::atomic<uint64_t> fullWaits;  //waits on a full buffer
+    std::atomic<uint64_t> emptyWaits;  //waits on an empty buffer
+    std::atomic<uint64_t> spuriousWakeups;  //wakeups that found the condition still false
+    Histogram latency;  //put to get of an item
+    Histogram lockHold;  //mutex held per critical section (split by waits)
+};
+
+class Metrics {
+public:
+    /**
+     * Returns true once start was called.
+     */
+    static bool enabled()
+    {
+        return on().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the current time in nanoseconds.
+     */
+    static uint64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /**
+     * Returns the calling thread's numbers, registering them on first use.
+     */
+    static ThreadMetrics &local()
+    {
+        static thread_local ThreadMetrics *mine = NULL;
+        if (!mine){
+            mine = new ThreadMetrics();
+            pthread_mutex_lock(&registryLock());
+            mine->id = (int) registry().size();
+            registry().push_back(mine);
+            pthread_mutex_unlock(&registryLock());
+        }
+        return *mine;
+    }
+
+    /**
+     * Starts recording, dumps at exit and on every SIGUSR1.  Call before creating threads.
+     *
+     * @param out where to print the dumps
+     */
+    static void start(FILE *out)
+    {
+        output() = out;
+        //construct the registry before atexit, so it is destroyed after the last dump
+        registry();
+
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+        pthread_t dumper;
+        if (pthread_create(&dumper, NULL, waitForSignals, NULL) != 0){
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(dumper);
+        atexit(dumpAtExit);
+        on().store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Prints every thread's counters and the added up counters and percentiles.
+     *
+     * @param out where to print
+     */
+    static void dump(FILE *out)
+    {
+        pthread_mutex_lock(&registryLock());
+        std::vector<ThreadMetrics *> threads = registry();
+        pthread_mutex_unlock(&registryLock());
+
+        uint64_t totals[5] = { 0, 0, 0, 0, 0 };
+        std::vector<uint64_t> latency(Histogram::BUCKETS), lockHold(Histogram::BUCKETS);
+        uint64_t latencyMax = 0, lockHoldMax = 0;
+
+        fprintf(out, "%-8s %12s %12s %12s %12s %12s\n", "thread", "puts", "gets", "full waits",
+                "empty waits", "spurious");
+        for (size_t i = 0; i < threads.size(); i++){
+            ThreadMetrics *t = threads[i];
+            uint64_t values[5] = {
+                t->puts.load(std::memory_order_relaxed), t->gets.load(std::memory_order_relaxed),
+                t->fullWaits.load(std::memory_order_relaxed),
+                t->emptyWaits.load(std::memory_order_relaxed),
+                t->spuriousWakeups.load(std::memory_order_relaxed)
+            };
+            fprintf(out, "%-8d %12llu %12llu %12llu %12llu %12llu\n", t->id,
+                    (unsigned long long) values[0], (unsigned long long) values[1],
+                    (unsigned long long) values[2], (unsigned long long) values[3],
+                    (unsigned long long) values[4]);
+            for (int k = 0; k < 5; k++)
+                totals[k] += values[k];
+            t->latency.addTo(latency.data(), latencyMax);
+            t->lockHold.addTo(lockHold.data(), lockHoldMax);
+        }
+        fprintf(out, "%-8s %12llu %12llu %12llu %12llu %12llu\n", "total",
+                (unsigned long long) totals[0], (unsigned long long) totals[1],
+                (unsigned long long) totals[2], (unsigned long long) totals[3],
+                (unsigned long long) totals[4]);
+
+        fprintf(out, "%-10s %10s %10s %10s %10s %10s %10s  (ns)\n", "", "count", "p50", "p90",
+                "p99", "p99.9", "max");
+        printPercentiles(out, "latency", latency.data(), latencyMax);
+        printPercentiles(out, "lock hold", lockHold.data(), lockHoldMax);
+        fflush(out);
+    }
+
+private:
+    static std::atomic<bool> &on()
+    {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    static pthread_mutex_t &registryLock()
+    {
+        static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        return lock;
+    }
+
+    static std::vector<ThreadMetrics *> &registry()
+    {
+        static std::vector<ThreadMetrics *> threads;
+        return threads;
+    }
+
+    static FILE *&output()
+    {
+        static FILE *out = stderr;
+        return out;
+    }
+
+    /**
+     * Prints the count and percentiles of an added up histogram.
+     */
+    static void printPercentiles(FILE *out, const char *name, const uint64_t *totals, uint64_t most)
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < Histogram::BUCKETS; i++)
+            total += totals[i];
+        fprintf(out, "%-10s %10llu", name, (unsigned long long) total);
+        const double percents[4] = { 50, 90, 99, 99.9 };
+        for (int i = 0; i < 4; i++)
+            fprintf(out, " %10llu", total ? (unsigned long long) Histogram::percentile(totals, total, percents[i], most) : 0ULL);
+        fprintf(out, " %10llu\n", (unsigned long long) most);
+    }
+
+    /**
+     * Body of the dumper thread: prints a dump for every SIGUSR1.
+     */
+    static void *waitForSignals(void *)
+    {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR1);
+        for (;;){
+            int sig;
+            if (sigwait(&set, &sig) == 0)
+                dump(output());
+        }
+        return NULL;
+    }
+
+    static void dumpAtExit()
+    {
+        dump(output());
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @author David Hines
+ * @file MpmcQueue.h
+ *
+ * Bounded lock-free queue for any number of producer and consumer threads (Dmitry Vyukov's
+ * design).  Every slot carries a sequence number that says whose turn the slot is: a slot at
+ * position p can be filled when its sequence is p, and emptied when its sequence is p + 1.
+ * A producer claims position p with a compare-and-swap of the enqueue position, writes the
+ * item and then stores p + 1 into the slot's sequence (release); a consumer claims p the
+ * same way on the dequeue position, reads the item and stores p + capacity, handing the slot
+ * to the producer of the next lap.  Producers only contend with producers on one cache line
+ * and consumers with consumers on another, and nobody waits on a thread that was preempted
+ * between its claim and its store except the one thread that needs that very slot.
+ *
+ * The capacity is set at run time and rounded up to a power of two (at least 2).  put and get
+ * spin a little (only with more than one core) when the queue is full or empty, then sleep on
+ * a futex event count (Futex.h) like BlockingSpscRing.
+ */
+
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include "Futex.h"
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+//tries before a blocked thread goes to sleep, with more than one core
+const int MPMC_SPIN_TRIES = 1000;
+
+template <typename T>
+class MpmcQueue {
+public:
+    /**
+     * Creates an empty queue.
+     *
+     * @param capacity most items the queue holds, rounded up to a power of two
+     */
+    explicit MpmcQueue(size_t capacity)
+        : spin(std::thread::hardware_concurrency() > 1 ? MPMC_SPIN_TRIES : 0),
+          enqueuePos(0), dequeuePos(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        mask = size - 1;
+        cells = new Cell[size];
+        for (size_t i = 0; i < size; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~MpmcQueue()
+    {
+        delete[] cells;
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    /**
+     * Adds an item unless the queue is full.
+     *
+     * @param item the item
+     * @return true if the item was added
+     */
+    bool tryPut(const T &item)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;){
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0){
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    cell.data = item;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Removes the oldest item unless the queue is empty.
+     *
+     * @param item where to store the item
+     * @return true if an item was removed
+     */
+    bool tryGet(T &item)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;){
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+            if (diff == 0){
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    item = cell.data;
+                    cell.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Adds an item, waiting while the queue is full.
+     *
+     * @param item the item
+     */
+    void put(const T &item)
+    {
+        int tries = 0;
+        while (!tryPut(item)){
+            if (++tries > spin){
+                notFull.waitUntil([&]{ return tryPut(item); });
+                break;
+            }
+            __builtin_ia32_pause();
+        }
+        notEmpty.notify();
+    }
+
+    /**
+     * Removes the oldest item, waiting while the queue is empty.
+     *
+     * @param item where to store the item
+     */
+    void get(T &item)
+    {
+        int tries = 0;
+        while (!tryGet(item)){
+            if (++tries > spin){
+                notEmpty.waitUntil([&]{ return tryGet(item); });
+                break;
+            }
+            __builtin_ia32_pause();
+        }
+        notFull.notify();
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    //one slot and its turn
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    Cell *cells;
+    size_t mask;  //capacity - 1
+    int spin;
+    alignas(64) std::atomic<size_t> enqueuePos;  //producers' line
+    alignas(64) std::atomic<size_t> dequeuePos;  //consumers' line
+    EventCount notEmpty;  //notified by producers after each put
+    EventCount notFull;  //notified by consumers after each get
+};
+
+#endif
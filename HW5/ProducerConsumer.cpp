@@ -1,105 +1,293 @@
 /*  ProducerConsumer.cpp  -- a sample program using
-    condition var +  mutex to produce  a monitor */
+    condition var +  mutex to produce  a monitor
 
-/*  Compile :  g++ ProducerConsumer.cpp -lpthread */
+    With -r the items go through a lock-free single producer/single
+    consumer ring instead (SpscRing.h), which only sleeps on a futex
+    when the ring is full or empty.  With -b N the monitor moves runs
+    of up to N items per critical section (putMany/getMany).  With -m
+    they go through the lock-free multi-producer/multi-consumer queue
+    (MpmcQueue.h).  With -z bytes each item is a message of that many
+    bytes in a slot of a pool (MessagePool.h): the producer fills the
+    slot in place and only the slot's index goes through the monitor
+    (or the -m queue); the consumer releases the slot after reading it.
+
+    -p and -c set the number of producer and consumer threads, -n the
+    capacity of the buffer and -i the number of items; the producers
+    share the items evenly and so do the consumers.
+
+    With -s the monitor records its metrics (Metrics.h): puts, gets,
+    waits on full and empty, spurious wakeups, and histograms of item
+    latency and lock hold time, printed to stderr at exit and whenever
+    the program gets SIGUSR1. */
+
+/*  Compile :  make ProducerConsumer
+    Usage   :  ./ProducerConsumer [-r | -b N | -m] [-z bytes] [-p producers]
+                                  [-c consumers] [-n capacity] [-i items] [-s] */
 #include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
+#include "BoundedBuffer.h"
+#include "MessagePool.h"
+#include "MpmcQueue.h"
+#include "SpscRing.h"
 
 using namespace std;
 
-pthread_t threads[2];  //Holds thread ids
+vector<pthread_t> threads;  //Holds thread ids
+
+//Default sizes, changed with -n and -i
+const int MAXBUF = 20;
+const int MAXITEMS = 500;
 
-//This is a mutex...a mutex is like the counting semaphores we went over
-pthread_mutex_t m1 = PTHREAD_MUTEX_INITIALIZER;
+int numProducers = 1;
+int numConsumers = 1;
+int maxBuf = MAXBUF;
+int numItems = MAXITEMS;
 
-//These are the condition variables for our monitor
-pthread_cond_t empty = PTHREAD_COND_INITIALIZER;
-pthread_cond_t full  = PTHREAD_COND_INITIALIZER;
+//Our monitor: the buffer with its mutex and condition variables (BoundedBuffer.h)
+BoundedBuffer<char> *buffer;
 
-//Our local variables/shared data
-int cnt = 0;
-int in = 0;
-int out = 0;
+//The lock-free ring used with -r (one producer and one consumer, MAXBUF slots)
+BlockingSpscRing<char, MAXBUF> ring;
+bool useRing = false;
 
-const int MAXBUF = 20;
-char buf[MAXBUF];
+//The lock-free queue used with -m
+MpmcQueue<char> *queue;
+bool useMpmc = false;
+
+//The message pool used with -z, its slots as many as the capacity, and the
+//queues of slot indexes
+MessagePool *pool;
+BoundedBuffer<uint32_t> *slotBuffer;
+MpmcQueue<uint32_t> *slotQueue;
+size_t msgSize = 0;
+
+//Items moved per critical section with -b
+int batch = 1;
+
+//Record the monitor's metrics with -s
+bool stats = false;
+
+/* Each report is built first and written with one call, so the lines of
+   different threads don't mix; single items are flushed as they go */
+void report(const char *what, const char *items, int n, bool flush)
+{
+  string lines;
+  for (int k = 0; k < n; k++)
+     lines.append(what).append(": ").append(1, items[k]).append("\n");
+  cout<<lines;
+  if (flush)
+     cout.flush();
+}
+
+void report(const char *what, char c)
+{
+  report(what, &c, 1, true);
+}
 
 /*** a monitor  ***/
 void producerPut(char c)
 {
-  pthread_mutex_lock( &m1 );  //Obtain the mutex
-  
-  while (cnt == MAXBUF)
-  {
-     cout <<"waiting on full\n";
-     pthread_cond_wait(&full,&m1); //Conditional wait
-  }
-  
-  buf[in] = c;
-  in = (in + 1) % MAXBUF;
-  cnt++;
-
-  cout<<"produced: "<<c<<endl;
-  
-  pthread_mutex_unlock( &m1 );      //Unlock the mutex
-  pthread_cond_signal( &empty );    //Signal consumers
+  buffer->put(c);
+  report("produced", c);
 }
 
 void consumerGet(char *c) {
-  pthread_mutex_lock( &m1 );
-  
-  while (cnt == 0)
-  {
-     cout <<"waiting on empty\n";
-     pthread_cond_wait(&empty, &m1);
-  }
-  
-  *c = buf[out];
-  out = (out + 1) % MAXBUF;
-  cnt--;
-
-  cout <<"consumed: "<<*c<<endl;
-  
-  pthread_mutex_unlock( &m1 );
-  pthread_cond_signal(&full);
+  *c = buffer->get();
+  report("consumed", *c);
+}
+
+/*** the lock-free ring ***/
+void ringPut(char c)
+{
+  ring.put(c);
+  report("produced", c);
+}
+
+void ringGet(char *c)
+{
+  ring.get(*c);
+  report("consumed", *c);
+}
+
+/*** the lock-free queue ***/
+void queuePut(char c)
+{
+  queue->put(c);
+  report("produced", c);
+}
+
+void queueGet(char *c)
+{
+  queue->get(*c);
+  report("consumed", *c);
 }
 
-/* producer/consumer threads */
-void * producer(void * dummy)
+/*** messages handed off through the pool ***/
+void messagePut(char c)
+{
+  uint32_t slot = pool->acquire();  //waits while every slot is in flight
+  memset(pool->data(slot), c, msgSize);
+  if (useMpmc)
+     slotQueue->put(slot);
+  else
+     slotBuffer->put(slot);
+  report("produced", c);
+}
+
+void messageGet(char *c)
+{
+  uint32_t slot;
+  if (useMpmc)
+     slotQueue->get(slot);
+  else
+     slot = slotBuffer->get();
+  *c = pool->data(slot)[msgSize - 1];
+  pool->release(slot);
+  report("consumed", *c);
+}
+
+/*** runs of items through the monitor ***/
+void producerPutMany(const char *run, int n)
+{
+  buffer->putMany(run, n);
+  report("produced", run, n, false);
+}
+
+int consumerGetMany(char *run, int max)
+{
+  int n = buffer->getMany(run, max);
+  report("consumed", run, n, false);
+  return n;
+}
+
+/* producer/consumer threads, passed their number */
+void * producer(void * index)
 {
   char c;
   int  j;
-  
-  for (j = 0; j < 500; j++) {
-     c = "abcdefghijklmnopqrstuvwxyz"[j%26];
-     producerPut(c);
+  int  first = (long long) numItems * (intptr_t) index / numProducers;
+  int  last = (long long) numItems * ((intptr_t) index + 1) / numProducers;
+
+  if (batch > 1) {
+     vector<char> run(batch);
+     for (j = first; j < last; j += batch) {
+        int n = last - j < batch ? last - j : batch;
+        for (int k = 0; k < n; k++)
+           run[k] = "abcdefghijklmnopqrstuvwxyz"[(j + k)%26];
+        producerPutMany(run.data(), n);
+     }
+  }
+  else {
+     for (j = first; j < last; j++) {
+        c = "abcdefghijklmnopqrstuvwxyz"[j%26];
+        if (msgSize)
+           messagePut(c);
+        else if (useRing)
+           ringPut(c);
+        else if (useMpmc)
+           queuePut(c);
+        else
+           producerPut(c);
+     }
   }
-  
+
   cout <<" producer finished \n";
+  return NULL;
 }
 
-void * consumer(void * dummy)
+void * consumer(void * index)
 {
   char c;
   int  j;
-  
-  for(j = 0; j < 500; j++) {
-     consumerGet(&c);
+  int  share = (long long) numItems * ((intptr_t) index + 1) / numConsumers
+             - (long long) numItems * (intptr_t) index / numConsumers;
+
+  if (batch > 1) {
+     vector<char> run(batch);
+     for (j = 0; j < share; )
+        j += consumerGetMany(run.data(), share - j < batch ? share - j : batch);
   }
-  
+  else {
+     for(j = 0; j < share; j++) {
+        if (msgSize)
+           messageGet(&c);
+        else if (useRing)
+           ringGet(&c);
+        else if (useMpmc)
+           queueGet(&c);
+        else
+           consumerGet(&c);
+     }
+  }
+
   cout <<" consumer finished \n";
+  return NULL;
 }
 
-int  main() {
-  int i; 
-  
-  pthread_create( &threads[0], NULL, producer,  NULL );
-  pthread_create(&threads[1], NULL, consumer,  NULL );
-  
- 
-  for (i = 0; i < 2; i++) { 
+int  main(int argc, char *argv[]) {
+  int i;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "rb:mz:p:c:n:i:s")) != -1) {
+     if (opt == 'r')
+        useRing = true;
+     else if (opt == 'b' && atoi(optarg) > 0)
+        batch = atoi(optarg);
+     else if (opt == 'm')
+        useMpmc = true;
+     else if (opt == 'z' && atol(optarg) > 0)
+        msgSize = atol(optarg);
+     else if (opt == 'p' && atoi(optarg) > 0)
+        numProducers = atoi(optarg);
+     else if (opt == 'c' && atoi(optarg) > 0)
+        numConsumers = atoi(optarg);
+     else if (opt == 'n' && atoi(optarg) > 0)
+        maxBuf = atoi(optarg);
+     else if (opt == 'i' && atoi(optarg) >= 0)
+        numItems = atoi(optarg);
+     else if (opt == 's')
+        stats = true;
+     else
+        optind = argc + 1;
+  }
+  if (optind != argc || useRing + (batch > 1) + useMpmc > 1 || (msgSize && (useRing || batch > 1))
+      || (useRing && (numProducers > 1 || numConsumers > 1 || maxBuf != MAXBUF))) {
+     cerr << "usage: " << argv[0] << " [-r | -b N | -m] [-z bytes] [-p producers] [-c consumers] [-n capacity] [-i items] [-s]\n"
+          << "       -r takes one producer, one consumer and the default capacity\n";
+     return 1;
+  }
+
+  if (stats)
+     Metrics::start(stderr);
+
+  BoundedBuffer<char> monitor(maxBuf);
+  MpmcQueue<char> lockFree(maxBuf);
+  buffer = &monitor;
+  queue = &lockFree;
+
+  MessagePool messages(msgSize ? maxBuf : 1, msgSize ? msgSize : 1);
+  BoundedBuffer<uint32_t> slotMonitor(maxBuf);
+  MpmcQueue<uint32_t> slotLockFree(maxBuf);
+  pool = &messages;
+  slotBuffer = &slotMonitor;
+  slotQueue = &slotLockFree;
+
+  threads.resize(numProducers + numConsumers);
+  for (i = 0; i < numProducers; i++)
+    pthread_create(&threads[i], NULL, producer, (void *) (intptr_t) i);
+  for (i = 0; i < numConsumers; i++)
+    pthread_create(&threads[numProducers + i], NULL, consumer, (void *) (intptr_t) i);
+
+
+  for (i = 0; i < numProducers + numConsumers; i++) {
     pthread_join (threads[i], NULL);
     cout  << "Joined thread with id  [" << threads[i] << "] \n";
   }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,288 @@
+/**
+ * @author David Hines
+ * @file ScalableBarrier.h
+ *
+ * Barriers for large thread counts, with the same interface as SenseBarrier: a group of
+ * count threads, numbered 0 to count - 1, calls wait(tid) any number of times, and wait
+ * returns true for exactly one thread per crossing.  SenseBarrier makes every arrival a
+ * read-modify-write of one counter, so at 64+ threads the arrivals queue up on that cache
+ * line; these spread the arrivals out.
+ *
+ * TreeBarrier is a combining tree: threads arrive at a leaf counter shared with at most
+ * fanIn - 1 others, and the last to arrive at a node carries the arrival up to the parent,
+ * so no counter ever sees more than fanIn arrivals per crossing.  The thread that completes
+ * the root moves the phase on and wakes everybody, like SenseBarrier.  The tree is NUMA
+ * aware: given the node each thread runs on, the threads of a node fill their own leaves and
+ * subtrees, so arrivals only cross between nodes near the root, fanIn at a time.
+ *
+ * DisseminationBarrier has no shared counter at all: in round r (of ceil(log2 count)) thread
+ * i signals thread (i + 2^r) mod count and waits for the signal of thread (i - 2^r) mod
+ * count.  After the last round every thread has heard from every other one, directly or
+ * not.  Each signal is an episode count on the receiver's own cache line, so there are
+ * count * log2(count) single-writer signals per crossing instead of count writes to one line.
+ *
+ * Waiters spin (only when every thread of the group can have a core of its own) and then
+ * sleep on futexes (PhaseWord, Futex.h).
+ */
+
+#ifndef SCALABLEBARRIER_H
+#define SCALABLEBARRIER_H
+
+#include "Futex.h"
+#include "SenseBarrier.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+
+//default number of arrivals combined per tree node
+const int TREE_FAN_IN = 4;
+
+/**
+ * Array of elements that start on a cache line each (for types aligned to a cache line), with
+ * the size fixed at construction.
+ */
+template <typename T>
+class CacheLineArray {
+public:
+    explicit CacheLineArray(size_t n) : size(n)
+    {
+        void *mem;
+        if (posix_memalign(&mem, 64, (n ? n : 1) * sizeof(T)) != 0){
+            perror("posix_memalign");
+            exit(EXIT_FAILURE);
+        }
+        items = static_cast<T *>(mem);
+        for (size_t i = 0; i < n; i++)
+            new (items + i) T();
+    }
+
+    ~CacheLineArray()
+    {
+        for (size_t i = 0; i < size; i++)
+            items[i].~T();
+        free(items);
+    }
+
+    CacheLineArray(const CacheLineArray &) = delete;
+    CacheLineArray &operator=(const CacheLineArray &) = delete;
+
+    T &operator[](size_t i) { return items[i]; }
+
+private:
+    T *items;
+    size_t size;
+};
+
+/**
+ * Returns the NUMA node of a CPU, from sysfs (0 if it can't be told).
+ *
+ * @param cpu the CPU
+ */
+inline int numaNodeOfCpu(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (!dir)
+        return 0;
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+        if (sscanf(entry->d_name, "node%d", &node) == 1)
+            break;
+    closedir(dir);
+    return node;
+}
+
+/**
+ * Returns the default spin tries for a group of threads: BARRIER_SPIN_TRIES when each can
+ * have a core of its own, 0 otherwise.
+ */
+inline int defaultSpin(int count)
+{
+    return (int) std::thread::hardware_concurrency() >= count ? BARRIER_SPIN_TRIES : 0;
+}
+
+class TreeBarrier {
+public:
+    /**
+     * Creates a combining tree barrier for a group of threads.
+     *
+     * @param count  number of threads
+     * @param nodeOf NUMA node of each thread, or empty when they all count as one node
+     * @param fanIn  most arrivals per tree node (at least 2)
+     * @param tries  tries before a waiter sleeps, or -1 for the default
+     */
+    explicit TreeBarrier(int count, const std::vector<int> &nodeOf = std::vector<int>(),
+                         int fanIn = TREE_FAN_IN, int tries = -1)
+        : total(count), spin(tries >= 0 ? tries : defaultSpin(count)), leafOf(count),
+          nodes(layout(nodeOf, fanIn < 2 ? 2 : fanIn))
+    {
+        for (size_t n = 0; n < arrivalsAt.size(); n++)
+            nodes[n].remaining.store(arrivalsAt[n], std::memory_order_relaxed);
+    }
+
+    TreeBarrier(const TreeBarrier &) = delete;
+    TreeBarrier &operator=(const TreeBarrier &) = delete;
+
+    /**
+     * Waits until every thread of the group has arrived.
+     *
+     * @param tid the caller's number in the group
+     * @return true for exactly one thread of each crossing (the one that completes the root)
+     */
+    bool wait(int tid)
+    {
+        uint32_t phase = sense.load();
+        int n = leafOf[tid];
+        for (;;){
+            if (nodes[n].remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                break;
+            //last to arrive here: reset the node for the next crossing and go up
+            nodes[n].remaining.store(arrivalsAt[n], std::memory_order_relaxed);
+            if (parentOf[n] < 0){
+                sense.advance();
+                return true;
+            }
+            n = parentOf[n];
+        }
+        sense.awaitChange(phase, spin);
+        return false;
+    }
+
+    int count() const { return total; }
+
+private:
+    //the arrival counter of a tree node
+    struct Node {
+        Node() : remaining(0) {}
+        alignas(64) std::atomic<int> remaining;  //arrivals still expected this crossing
+    };
+
+    /**
+     * Lays the tree out level by level: the items of a level (threads, then nodes), sorted by
+     * NUMA node, are grouped fanIn at a time into the nodes of the next level, without putting
+     * items of different NUMA nodes in one group until every NUMA node is down to one item.
+     *
+     * @return the number of tree nodes
+     */
+    size_t layout(const std::vector<int> &nodeOf, int fanIn)
+    {
+        //items of the current level: NUMA node and index (thread, or tree node)
+        std::vector<std::pair<int, int>> items;
+        for (int t = 0; t < total; t++)
+            items.push_back(std::make_pair(t < (int) nodeOf.size() ? nodeOf[t] : 0, t));
+        std::stable_sort(items.begin(), items.end());
+
+        bool leaves = true;
+        while (leaves || items.size() > 1){
+            //one item per NUMA node left: the groups can mix NUMA nodes from now on
+            bool mix = true;
+            for (size_t i = 1; i < items.size(); i++)
+                if (items[i].first == items[i - 1].first)
+                    mix = false;
+
+            std::vector<std::pair<int, int>> next;
+            for (size_t i = 0; i < items.size(); ){
+                size_t j = i;
+                while (j < items.size() && j - i < (size_t) fanIn
+                       && (mix || items[j].first == items[i].first))
+                    j++;
+
+                int n = arrivalsAt.size();
+                arrivalsAt.push_back(j - i);
+                parentOf.push_back(-1);
+                for (size_t k = i; k < j; k++){
+                    if (leaves)
+                        leafOf[items[k].second] = n;
+                    else
+                        parentOf[items[k].second] = n;
+                }
+                next.push_back(std::make_pair(mix ? -1 : items[i].first, n));
+                i = j;
+            }
+            items.swap(next);
+            leaves = false;
+        }
+        return arrivalsAt.size();
+    }
+
+    const int total;
+    const int spin;
+    //the shape of the tree, only read once built
+    std::vector<int> leafOf;  //leaf node of each thread
+    std::vector<int> arrivalsAt;  //arrivals per crossing of each node
+    std::vector<int> parentOf;  //parent of each node, -1 for the root
+    CacheLineArray<Node> nodes;
+    PhaseWord sense;  //phase, moved on by the thread that completes the root
+};
+
+class DisseminationBarrier {
+public:
+    /**
+     * Creates a dissemination barrier for a group of threads.
+     *
+     * @param count number of threads
+     * @param tries tries before a waiter sleeps, or -1 for the default
+     */
+    explicit DisseminationBarrier(int count, int tries = -1)
+        : total(count), spin(tries >= 0 ? tries : defaultSpin(count)),
+          rounds(roundsFor(count)), episodes(count), flags(count * rounds)
+    {
+    }
+
+    DisseminationBarrier(const DisseminationBarrier &) = delete;
+    DisseminationBarrier &operator=(const DisseminationBarrier &) = delete;
+
+    /**
+     * Waits until every thread of the group has arrived.
+     *
+     * @param tid the caller's number in the group
+     * @return true for exactly one thread of each crossing (thread 0)
+     */
+    bool wait(int tid)
+    {
+        //episodes are only touched by their own thread
+        uint32_t episode = ++episodes[tid].value;
+        for (int r = 0, step = 1; r < rounds; r++, step *= 2){
+            flags[((tid + step) % total) * rounds + r].advance();
+            //the flag counts this round's signals, one per episode; a partner that is already
+            //in the next episode may have moved it on twice, so wait for any change
+            flags[tid * rounds + r].awaitChange(episode - 1, spin);
+        }
+        return tid == 0;
+    }
+
+    int count() const { return total; }
+
+private:
+    //a thread's episode count, on a line of its own
+    struct Episode {
+        Episode() : value(0) {}
+        alignas(64) uint32_t value;
+    };
+
+    /**
+     * Returns the number of rounds for a group: ceil(log2 count).
+     */
+    static int roundsFor(int count)
+    {
+        int r = 0;
+        while ((1 << r) < count)
+            r++;
+        return r;
+    }
+
+    const int total;
+    const int spin;
+    const int rounds;
+    CacheLineArray<Episode> episodes;
+    CacheLineArray<PhaseWord> flags;  //count x rounds signals, received by thread / round
+};
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @author David Hines
+ * @file SenseBarrier.h
+ *
+ * Reusable sense-reversing barrier.  The barrier can be crossed any number of times by the
+ * same group of threads, which is what the per-iteration barriers of data-parallel loops need.
+ *
+ * The sense is a phase counter (its parity is the classic sense bit): each arriving thread
+ * reads the phase, then counts itself off.  The last one to arrive resets the count for the
+ * next crossing before it moves the phase on, so a thread that races ahead into the next
+ * crossing always finds a full count, and the waiters of this crossing only ever wait for the
+ * phase they read to change.  Waiters spin on the phase for a while (only when every thread
+ * of the group can have a core of its own) and then sleep on it as a futex; the last thread
+ * wakes every sleeper with one FUTEX_WAKE, and only makes that system call when somebody has
+ * said it is going to sleep.
+ */
+
+#ifndef SENSEBARRIER_H
+#define SENSEBARRIER_H
+
+#include "Futex.h"
+#include <atomic>
+#include <thread>
+
+//default tries before a waiter sleeps, when the threads have cores of their own
+const int BARRIER_SPIN_TRIES = 4000;
+
+class SenseBarrier {
+public:
+    /**
+     * Creates a barrier for a group of threads.
+     *
+     * @param count number of threads that cross the barrier together
+     * @param tries tries before a waiter sleeps, or -1 for BARRIER_SPIN_TRIES when there are
+     *              at least count cores and 0 otherwise
+     */
+    explicit SenseBarrier(int count, int tries = -1)
+        : total(count), spin(tries >= 0 ? tries : (int) std::thread::hardware_concurrency() >= count
+                                                  ? BARRIER_SPIN_TRIES : 0),
+          remaining(count)
+    {
+    }
+
+    SenseBarrier(const SenseBarrier &) = delete;
+    SenseBarrier &operator=(const SenseBarrier &) = delete;
+
+    /**
+     * Waits until every thread of the group has arrived.  Everything a thread did before it
+     * arrived is visible to every thread after it leaves.
+     *
+     * @return true for exactly one thread of each crossing (the last to arrive)
+     */
+    bool wait()
+    {
+        uint32_t phase = sense.load();
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1){
+            remaining.store(total, std::memory_order_relaxed);
+            sense.advance();
+            return true;
+        }
+        sense.awaitChange(phase, spin);
+        return false;
+    }
+
+    /**
+     * Same as wait(), for code written against the barriers that need to know the caller
+     * (see ScalableBarrier.h); the caller's number in the group is not needed here.
+     */
+    bool wait(int)
+    {
+        return wait();
+    }
+
+    int count() const { return total; }
+
+private:
+    const int total;
+    const int spin;
+    alignas(64) std::atomic<int> remaining;  //threads still to arrive at this crossing
+    PhaseWord sense;  //phase, the futex word the waiters sleep on
+};
+
+#endif
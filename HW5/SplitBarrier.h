@@ -0,0 +1,126 @@
+/**
+ * @author David Hines
+ * @file SplitBarrier.h
+ *
+ * Reusable split-phase barrier, after std::barrier's arrive and wait: a thread arrives when
+ * its part of the phase is done, keeps doing work that does not depend on the others, and
+ * only waits for the phase to end when it needs the result.  Crossing it in one step
+ * (arriveAndWait) works like SenseBarrier.
+ *
+ * A completion function can be given, which the barrier runs once per phase, on the last
+ * thread to arrive, after every thread has arrived and before any of them is let go: it sees
+ * everything the threads did before they arrived, and they see everything it did once their
+ * wait returns.  It runs inside the arrival itself, with no lock around it, and the threads
+ * only wait on the phase moving on (PhaseWord, Futex.h), which the last thread does once the
+ * completion function has returned.
+ *
+ * Each thread must wait for a phase before it arrives again.
+ */
+
+#ifndef SPLITBARRIER_H
+#define SPLITBARRIER_H
+
+#include "Futex.h"
+#include "SenseBarrier.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+class SplitBarrier {
+public:
+    /**
+     * Creates a split-phase barrier for a group of threads.
+     *
+     * @param count      number of threads that cross the barrier together
+     * @param completion function run once per phase by the last thread to arrive, or empty
+     * @param tries      tries before a waiter sleeps, or -1 for BARRIER_SPIN_TRIES when there
+     *                   are at least count cores and 0 otherwise
+     */
+    explicit SplitBarrier(int count, std::function<void()> completion = std::function<void()>(),
+                          int tries = -1)
+        : total(count), spin(tries >= 0 ? tries : (int) std::thread::hardware_concurrency() >= count
+                                                  ? BARRIER_SPIN_TRIES : 0),
+          onPhase(completion), remaining(count)
+    {
+    }
+
+    SplitBarrier(const SplitBarrier &) = delete;
+    SplitBarrier &operator=(const SplitBarrier &) = delete;
+
+    /**
+     * Counts the caller off for the current phase without waiting.  The last thread to arrive
+     * runs the completion function and ends the phase.
+     *
+     * @return the phase arrived at, to give to wait() or done()
+     */
+    uint32_t arrive()
+    {
+        uint32_t phase;
+        countOff(phase);
+        return phase;
+    }
+
+    /**
+     * Returns whether a phase has ended, without waiting.
+     *
+     * @param phase the phase, from arrive()
+     */
+    bool done(uint32_t phase) const
+    {
+        return sense.load() != phase;
+    }
+
+    /**
+     * Waits until a phase has ended.
+     *
+     * @param phase the phase, from arrive()
+     */
+    void wait(uint32_t phase)
+    {
+        sense.awaitChange(phase, spin);
+    }
+
+    /**
+     * Arrives and waits for the phase to end.
+     *
+     * @return true for exactly one thread of each phase (the last to arrive)
+     */
+    bool arriveAndWait()
+    {
+        uint32_t phase;
+        if (countOff(phase))
+            return true;
+        wait(phase);
+        return false;
+    }
+
+    int count() const { return total; }
+
+private:
+    /**
+     * Counts the caller off; the last thread runs the completion function, resets the count
+     * for the next phase and then moves the phase on.
+     *
+     * @param phase where to store the phase arrived at
+     * @return true for the last thread to arrive
+     */
+    bool countOff(uint32_t &phase)
+    {
+        phase = sense.load();
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return false;
+        if (onPhase)
+            onPhase();
+        remaining.store(total, std::memory_order_relaxed);
+        sense.advance();
+        return true;
+    }
+
+    const int total;
+    const int spin;
+    const std::function<void()> onPhase;
+    alignas(64) std::atomic<int> remaining;  //threads still to arrive in this phase
+    PhaseWord sense;  //phase, the futex word the waiters sleep on
+};
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * @author David Hines
+ * @file SpscRing.h
+ *
+ * Lock-free ring buffer for exactly one producer thread and one consumer thread.
+ *
+ * The producer only ever writes the tail index and the consumer only ever writes the head
+ * index; each index sits on its own cache line together with its owner's cached copy of the
+ * other index, so the two threads only touch each other's line when the cached copy says the
+ * ring looks full (producer) or empty (consumer).  A slot is published with a release store
+ * of the index after it has been written, and read after an acquire load of the index.  The
+ * indexes count up forever and are reduced modulo N, so all N slots are used.
+ *
+ * BlockingSpscRing adds put and get that wait when the ring is full or empty: they spin a
+ * little (only with more than one core), then sleep on a futex event count, and the other
+ * side only makes a wake system call when somebody is actually asleep.  A producer blocked on
+ * a full ring is only woken once the ring is down to half full, so it gets to refill a run of
+ * slots per wakeup instead of one: while the producer is blocked the backlog the consumer
+ * sees only shrinks, and it must pass N/2 before the consumer could block on an empty ring.
+ */
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include "Futex.h"
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+//tries before a blocked thread goes to sleep, with more than one core
+const int SPSC_SPIN_TRIES = 1000;
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N > 0, "the ring needs at least one slot");
+
+public:
+    SpscRing() : head(0), cachedTail(0), tail(0), cachedHead(0) {}
+
+    /**
+     * Adds an item unless the ring is full.  Only call from the producer.
+     *
+     * @param item the item
+     * @return true if the item was added
+     */
+    bool tryPut(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == N){
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == N)
+                return false;
+        }
+        slots[t % N] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the oldest item unless the ring is empty.  Only call from the consumer.
+     *
+     * @param item where to store the item
+     * @return true if an item was removed
+     */
+    bool tryGet(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail){
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+        item = slots[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Returns true if the ring looks empty (exact only from the consumer).
+     */
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns true if the ring looks full (exact only from the producer).
+     */
+    bool full() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) == N;
+    }
+
+    /**
+     * Returns a lower bound of the number of items in the ring, from the consumer's cached
+     * copy of the tail, without touching the producer's line.  Only call from the consumer.
+     */
+    size_t backlog() const
+    {
+        return cachedTail - head.load(std::memory_order_relaxed);
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    //consumer's line
+    alignas(64) std::atomic<size_t> head;
+    size_t cachedTail;
+    //producer's line
+    alignas(64) std::atomic<size_t> tail;
+    size_t cachedHead;
+    alignas(64) T slots[N];
+};
+
+template <typename T, size_t N>
+class BlockingSpscRing {
+public:
+    BlockingSpscRing() : spin(std::thread::hardware_concurrency() > 1 ? SPSC_SPIN_TRIES : 0) {}
+
+    /**
+     * Adds an item, waiting while the ring is full.  Only call from the producer.
+     *
+     * @param item the item
+     */
+    void put(const T &item)
+    {
+        int tries = 0;
+        while (!ring.tryPut(item)){
+            if (++tries > spin){
+                notFull.waitUntil([&]{ return ring.tryPut(item); });
+                break;
+            }
+            __builtin_ia32_pause();
+        }
+        notEmpty.notify();
+    }
+
+    /**
+     * Removes the oldest item, waiting while the ring is empty.  Only call from the consumer.
+     *
+     * @param item where to store the item
+     */
+    void get(T &item)
+    {
+        int tries = 0;
+        while (!ring.tryGet(item)){
+            if (++tries > spin){
+                notEmpty.waitUntil([&]{ return ring.tryGet(item); });
+                break;
+            }
+            __builtin_ia32_pause();
+        }
+        if (ring.backlog() <= N / 2)
+            notFull.notify();
+    }
+
+    /**
+     * Adds an item unless the ring is full, without waiting.
+     *
+     * @param item the item
+     * @return true if the item was added
+     */
+    bool tryPut(const T &item)
+    {
+        if (!ring.tryPut(item))
+            return false;
+        notEmpty.notify();
+        return true;
+    }
+
+    /**
+     * Removes the oldest item unless the ring is empty, without waiting.
+     *
+     * @param item where to store the item
+     * @return true if an item was removed
+     */
+    bool tryGet(T &item)
+    {
+        if (!ring.tryGet(item))
+            return false;
+        if (ring.backlog() <= N / 2)
+            notFull.notify();
+        return true;
+    }
+
+private:
+    SpscRing<T, N> ring;
+    EventCount notEmpty;  //notified by the producer after each put
+    EventCount notFull;  //notified by the consumer after each get leaving the ring half empty
+    int spin;
+};
+
+#endif
@@ -2,89 +2,131 @@
  * @author David Hines
  * @file barrier.cpp
  *
- * This program demonstrates monitors to syncronize threads by creating a
- * barrier where threads wait for signaling before continuing.  The threads
- * are created then passed the Restaurant function which in turn calls the
- * waitForOthers function.  In waitForOthers, the threads will attempt to
- * lock the mutex and then will update the shared data of totalThreads and
- * taskWhileWaiting.  The global data is then used to set some local variables
- * for the thread and print out the thread number, task and state of execution.
+ * This program demonstrates a barrier where threads wait for each other before continuing.
+ * The threads are created then passed the Restaurant function which in turn calls the
+ * waitForOthers function once per course.  In waitForOthers, each thread takes the next
+ * arrival number and task letter of the course, prints them and then waits at the barrier
+ * until every thread of the table has arrived; then all of them eat.
  *
- * All of the threads will wait for a signal until the last thread arrives. The
- * last thread will unlock the mutex and also signal to the other threads using
- * the pthread_cond_t notFull signal.  When the signal is sent, the first threads
- * will continue processing until exit.
+ * The barrier is a reusable split-phase barrier (SplitBarrier.h), so the same barrier is
+ * crossed once per course, and a thread doesn't block as soon as its task is done: it arrives,
+ * reads the menu (work that doesn't need the others, -w microseconds of it) and only then
+ * waits to be served.  Serving the course is the barrier's completion function, run once per
+ * course by the last thread to arrive, before the others are let go; it takes no lock, and
+ * the last thread then wakes all the others at once with one futex broadcast.  Nothing is
+ * printed while a lock is held and no lock is taken at all.
  *
  * Computing Environment:     NCSU College of Engineering EOS Computing Environment
- * Compile command:           g++ -Wall -std=c++11 barrier.cpp -o barrier -lpthread
+ * Compile command:           make barrier
  *
+ * Usage: ./barrier [-t threads] [-c courses] [-w menu microseconds]
  */
 
 #include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include "SplitBarrier.h"
 using namespace std;
 
-pthread_mutex_t m1   = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t notFull = PTHREAD_COND_INITIALIZER;
-int totalThreads = 0;
-char taskWhileWaiting = 'A';
+//default number of threads at the table and of courses
+const int THREADS = 4;
+const int COURSES = 1;
 
-void waitForOthers();
+int numThreads = THREADS;
+int numCourses = COURSES;
+int menuUs = 0;  //time each thread spends reading the menu, in microseconds
+SplitBarrier *table;
+atomic<int> arrivals(0);  //threads that have arrived, over all courses
+int served = 0;  //courses served, only changed by the completion function
+
+void serveCourse();
+
+void waitForOthers(int course);
 
 void * Restaurant(void * param);
 
 /**
  * Start of main program
  */
-int main(){
-
-   pthread_t hungryThd[4];
-   pthread_attr_t attr;
-   pthread_attr_init(&attr);
+int main(int argc, char *argv[]){
+
+   int opt;
+   while ((opt = getopt(argc, argv, "t:c:w:")) != -1){
+      if (opt == 't' && atoi(optarg) > 0)
+         numThreads = atoi(optarg);
+      else if (opt == 'c' && atoi(optarg) > 0)
+         numCourses = atoi(optarg);
+      else if (opt == 'w' && atoi(optarg) >= 0)
+         menuUs = atoi(optarg);
+      else {
+         cerr << "usage: " << argv[0] << " [-t threads] [-c courses] [-w menu microseconds]" << endl;
+         return 1;
+      }
+   }
+
+   SplitBarrier barrier(numThreads, serveCourse);
+   table = &barrier;
+   vector<pthread_t> hungryThd(numThreads);
 
    // create threads
-   for (int i = 0; i < 4; i++)
+   for (int i = 0; i < numThreads; i++)
       pthread_create(&hungryThd[i],NULL,Restaurant,NULL);
 
    // join threads
-   for (int i = 0; i < 4; i++)
+   for (int i = 0; i < numThreads; i++)
       pthread_join(hungryThd[i],NULL);
 
    return 0;
 }
 
 /**
- * Wait for others function that enables threads to lock a mutex
- * and then update global shared data and set some local variables
- * with those updates.  The thread then will print its id, task, and
- * then wait for a signal that all threads have arrived before
- * continuing (unless it is the last thread).  The final thread to
- * arrive will unlock the mutex after data updates and finally will
- * signal to the other threads that it is time to eat.
+ * Completion function of the barrier: runs once per course, on the last thread to arrive,
+ * once everyone is here and before anyone eats.
+ */
+void serveCourse(){
+
+   served++;
+   ostringstream serving;
+   serving<<"Everyone is here, serving course "<<served<<"."<<endl;
+   cout<<serving.str();
+}
+
+/**
+ * Wait for others function: the thread takes the next arrival number of the course and the
+ * task letter that goes with it, prints them, and arrives at the barrier.  It then reads the
+ * menu, which doesn't need the others, and only waits for the course to be served when it is
+ * done with that.  Lines are built first and written with one call, so lines of different
+ * threads don't mix.
  *
+ * @param course the course (0 based)
  */
-void waitForOthers(){
+void waitForOthers(int course){
 
-   int id;
-   char ltr;
-   // add barrier and output code here
-   pthread_mutex_lock(&m1);
+   int id = arrivals.fetch_add(1) - course * numThreads + 1;
+   char ltr = 'A' + (id - 1) % 26;
 
-   id = ++totalThreads;
-   if (id > 1)
-      ltr = ++taskWhileWaiting;
-   else
-      ltr = taskWhileWaiting;
+   ostringstream waiting;
+   waiting<<"I am thread "<<id<<", working on Task "<<ltr<<" and waiting to eat."<<endl;
+   cout<<waiting.str();
 
-   cout<<"I am thread "<<id<<", working on Task "<<ltr<<" and waiting to eat."<<endl;
-   if (totalThreads < 4)
-      pthread_cond_wait(&notFull, &m1);
+   uint32_t phase = table->arrive();
 
-   cout<<"I am thread "<<id<<" and I am eating."<<endl;
+   ostringstream reading;
+   reading<<"I am thread "<<id<<" and I am reading the menu."<<endl;
+   cout<<reading.str();
+   if (menuUs > 0)
+      usleep(menuUs);
 
-   pthread_mutex_unlock(&m1);
-   pthread_cond_signal(&notFull);
+   // the course is served once the phase is over
+   table->wait(phase);
 
+   ostringstream eating;
+   eating<<"I am thread "<<id<<" and I am eating course "<<served<<"."<<endl;
+   cout<<eating.str();
 }
 
 /**
@@ -95,8 +137,9 @@ void waitForOthers(){
  */
 void * Restaurant(void * param){
 
-    // call wait function
-   waitForOthers();
+    // call wait function once per course
+    for (int course = 0; course < numCourses; course++)
+       waitForOthers(course);
 
    pthread_exit(NULL);
 
@@ -0,0 +1,266 @@
+/**
+ * @author David Hines
+ * @file barrierbench.cpp
+ *
+ * Benchmark of barrier crossing latency: the sense-reversing barrier (SenseBarrier.h), the
+ * combining tree and dissemination barriers (ScalableBarrier.h), pthread_barrier_t, and a
+ * reusable mutex + condition variable barrier like the one barrier.cpp's waitForOthers used
+ * to be built on.  For every thread count the threads cross the barrier back to back, with
+ * nothing in between, and the time per crossing (start of the first to end of the last, over
+ * the number of crossings) is printed for each barrier.  Crossings get fewer as the thread
+ * count goes up, so that every count takes about as long.
+ *
+ * With -p thread i is pinned to CPU i mod the number of CPUs, and the tree is given the NUMA
+ * node of each thread's CPU so that it combines the arrivals of a node before crossing nodes.
+ *
+ * Compilation: use provided Makefile
+ *              -usage: "make barrierbench"
+ *
+ * Usage: ./barrierbench [-t thread counts] [-n crossings] [-f fan in] [-b barriers] [-p]
+ *        thread counts is a comma separated list (default 2,4,...,256); crossings are for
+ *        2 threads; barriers: sense,tree,dissemination,pthread,condvar
+ */
+
+#include "SenseBarrier.h"
+#include "ScalableBarrier.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+//default crossings with 2 threads
+const long CROSSINGS = 100000;
+//fewest crossings of any run
+const long MIN_CROSSINGS = 50;
+//most counts in a list
+const int MAX_COUNTS = 16;
+
+/**
+ * Returns the current time in nanoseconds.
+ */
+uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * pthread_barrier_t behind the interface of the other barriers.
+ */
+class PthreadBarrier {
+public:
+    explicit PthreadBarrier(int count)
+    {
+        pthread_barrier_init(&barrier, NULL, count);
+    }
+
+    ~PthreadBarrier()
+    {
+        pthread_barrier_destroy(&barrier);
+    }
+
+    bool wait(int)
+    {
+        return pthread_barrier_wait(&barrier) == PTHREAD_BARRIER_SERIAL_THREAD;
+    }
+
+private:
+    pthread_barrier_t barrier;
+};
+
+/**
+ * Mutex + condition variable barrier: every arrival takes the one lock, and the last one
+ * starts a new generation and broadcasts.
+ */
+class CondvarBarrier {
+public:
+    explicit CondvarBarrier(int count) : total(count), remaining(count), generation(0) {}
+
+    bool wait(int)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (--remaining == 0){
+            remaining = total;
+            generation++;
+            everyoneHere.notify_all();
+            return true;
+        }
+        unsigned long mine = generation;
+        while (generation == mine)
+            everyoneHere.wait(lock);
+        return false;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable everyoneHere;
+    const int total;
+    int remaining;
+    unsigned long generation;
+};
+
+/**
+ * Pins the calling thread to a CPU.
+ *
+ * @param cpu the CPU
+ */
+void pinTo(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/**
+ * Runs one barrier with one thread count.
+ *
+ * @param b         the barrier, for threads threads
+ * @param threads   number of threads
+ * @param crossings number of crossings timed
+ * @param pin       pin the threads to CPUs
+ * @return microseconds per crossing
+ */
+template <typename Barrier>
+double run(Barrier &b, int threads, long crossings, bool pin)
+{
+    int cpus = std::thread::hardware_concurrency();
+    uint64_t start = 0, end = 0;
+    std::vector<std::thread> group;
+
+    for (int t = 0; t < threads; t++)
+        group.push_back(std::thread([&b, &start, &end, t, crossings, pin, cpus]{
+            if (pin)
+                pinTo(t % cpus);
+            //one crossing untimed, so every thread has started
+            b.wait(t);
+            if (t == 0)
+                start = nowNs();
+            for (long k = 0; k < crossings; k++)
+                b.wait(t);
+            if (t == 0)
+                end = nowNs();
+        }));
+    for (size_t i = 0; i < group.size(); i++)
+        group[i].join();
+    return (end - start) / 1e3 / crossings;
+}
+
+/**
+ * Reads a comma separated list of positive counts.
+ *
+ * @param list   the list
+ * @param counts where to store the counts
+ * @return number of counts
+ */
+int readCounts(const char *list, int *counts)
+{
+    int n = 0;
+    for (const char *p = list; *p && n < MAX_COUNTS; p += strcspn(p, ","), p += *p == ',')
+        if (atoi(p) > 0)
+            counts[n++] = atoi(p);
+    return n;
+}
+
+/**
+ * Main program for the barrier benchmark
+ * @param argc the number of arguments passed from commandline
+ * @param argv the array of strings passed from commandline
+ * @return exit status
+ */
+int main(int argc, char *argv[])
+{
+    int threadCounts[MAX_COUNTS];
+    int numCounts = readCounts("2,4,8,16,32,64,128,256", threadCounts);
+    long crossings = CROSSINGS;
+    int fanIn = TREE_FAN_IN;
+    const char *barriers = "sense,tree,dissemination,pthread,condvar";
+    bool pin = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:f:b:p")) != -1){
+        switch (opt){
+        case 't':
+            numCounts = readCounts(optarg, threadCounts);
+            break;
+        case 'n':
+            crossings = atol(optarg);
+            break;
+        case 'f':
+            fanIn = atoi(optarg);
+            break;
+        case 'b':
+            barriers = optarg;
+            break;
+        case 'p':
+            pin = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t thread counts] [-n crossings] [-f fan in] [-b barriers] [-p]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (numCounts == 0 || crossings < 1 || fanIn < 2){
+        fprintf(stderr, "Invalid thread counts, crossings or fan in\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%u CPUs, tree fan in %d%s, microseconds per crossing\n",
+           std::thread::hardware_concurrency(), fanIn, pin ? ", pinned" : "");
+    printf("%7s %9s", "threads", "crossings");
+    const char *names[] = { "sense", "tree", "dissemination", "pthread", "condvar" };
+    for (int i = 0; i < 5; i++)
+        if (strstr(barriers, names[i]))
+            printf(" %13s", names[i]);
+    printf("\n");
+
+    int cpus = std::thread::hardware_concurrency();
+    for (int i = 0; i < numCounts; i++){
+        int threads = threadCounts[i];
+        long n = crossings * 2 / threads;
+        if (n < MIN_CROSSINGS)
+            n = MIN_CROSSINGS;
+        printf("%7d %9ld", threads, n);
+        fflush(stdout);
+
+        if (strstr(barriers, "sense")){
+            SenseBarrier b(threads);
+            printf(" %13.2f", run(b, threads, n, pin));
+            fflush(stdout);
+        }
+        if (strstr(barriers, "tree")){
+            std::vector<int> nodeOf;
+            for (int t = 0; pin && t < threads; t++)
+                nodeOf.push_back(numaNodeOfCpu(t % cpus));
+            TreeBarrier b(threads, nodeOf, fanIn);
+            printf(" %13.2f", run(b, threads, n, pin));
+            fflush(stdout);
+        }
+        if (strstr(barriers, "dissemination")){
+            DisseminationBarrier b(threads);
+            printf(" %13.2f", run(b, threads, n, pin));
+            fflush(stdout);
+        }
+        if (strstr(barriers, "pthread")){
+            PthreadBarrier b(threads);
+            printf(" %13.2f", run(b, threads, n, pin));
+            fflush(stdout);
+        }
+        if (strstr(barriers, "condvar")){
+            CondvarBarrier b(threads);
+            printf(" %13.2f", run(b, threads, n, pin));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/**
+ * @author David Hines
+ * @file queuebench.cpp
+ *
+ * Benchmark of the bounded queues under contention: the mutex + condition variable monitor
+ * (BoundedBuffer.h) against the lock-free multi-producer/multi-consumer queue (MpmcQueue.h).
+ * For every combination of producer and consumer counts, the producers share the items
+ * evenly and stamp each one with the time it was put; the consumers take items until each
+ * gets a stop item (put after the producers are done) and record the time from put to get.
+ * Throughput (items per second, start of the first put to the last get) and the median,
+ * 99th, 99.9th percentile and largest latency are printed for each queue.
+ *
+ * Compilation: use provided Makefile
+ *              -usage: "make queuebench"
+ *
+ * Usage: ./queuebench [-p producer counts] [-c consumer counts] [-n capacity] [-i items]
+ *                     [-q queues]
+ *        counts are comma separated lists (default 1,2,4); queues: monitor,mpmc
+ */
+
+#include "BoundedBuffer.h"
+#include "MpmcQueue.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+//default queue capacity
+const size_t CAPACITY = 1024;
+//default number of items per run
+const long ITEMS = 1000000;
+//sequence number of the item that tells a consumer to stop
+const uint64_t STOP = UINT64_MAX;
+//most counts in a list
+const int MAX_COUNTS = 16;
+
+//item passed through the queues
+struct Item {
+    uint64_t stamp;  //time of the put, in nanoseconds
+    uint64_t seq;
+};
+
+/**
+ * Returns the current time in nanoseconds.
+ */
+uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Lets the monitor and the lock-free queue be driven by the same code.
+ */
+void putItem(BoundedBuffer<Item> &q, const Item &item) { q.put(item); }
+void getItem(BoundedBuffer<Item> &q, Item &item) { item = q.get(); }
+void putItem(MpmcQueue<Item> &q, const Item &item) { q.put(item); }
+void getItem(MpmcQueue<Item> &q, Item &item) { q.get(item); }
+
+/**
+ * Runs one configuration and prints its line.
+ *
+ * @param name      name of the queue
+ * @param q         the queue, empty
+ * @param producers number of producer threads
+ * @param consumers number of consumer threads
+ * @param items     number of items in all
+ */
+template <typename Queue>
+void run(const char *name, Queue &q, int producers, int consumers, long items)
+{
+    std::vector<std::vector<uint64_t>> latencies(consumers);
+    std::vector<std::thread> threads;
+    uint64_t start = nowNs();
+
+    for (int c = 0; c < consumers; c++)
+        threads.push_back(std::thread([&q, &latencies, c, items, consumers]{
+            std::vector<uint64_t> &lat = latencies[c];
+            lat.reserve(items / consumers + items / 8);
+            Item item;
+            for (;;){
+                getItem(q, item);
+                if (item.seq == STOP)
+                    break;
+                lat.push_back(nowNs() - item.stamp);
+            }
+        }));
+
+    std::vector<std::thread> putters;
+    for (int p = 0; p < producers; p++)
+        putters.push_back(std::thread([&q, p, items, producers]{
+            long first = items * p / producers;
+            long last = items * (p + 1) / producers;
+            for (long i = first; i < last; i++){
+                Item item = { nowNs(), (uint64_t) i };
+                putItem(q, item);
+            }
+        }));
+    for (size_t i = 0; i < putters.size(); i++)
+        putters[i].join();
+
+    for (int c = 0; c < consumers; c++){
+        Item stop = { 0, STOP };
+        putItem(q, stop);
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    double secs = (nowNs() - start) / 1e9;
+
+    std::vector<uint64_t> all;
+    all.reserve(items);
+    for (int c = 0; c < consumers; c++)
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    if ((long) all.size() != items){
+        fprintf(stderr, "%s lost items: %zu of %ld\n", name, all.size(), items);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t ranks[3] = { all.size() / 2, all.size() * 99 / 100, all.size() * 999 / 1000 };
+    uint64_t values[3];
+    for (int i = 0; i < 3; i++){
+        std::nth_element(all.begin(), all.begin() + ranks[i], all.end());
+        values[i] = all[ranks[i]];
+    }
+    uint64_t max = *std::max_element(all.begin(), all.end());
+
+    printf("%-8s %3d %3d %12.0f %10.1f %10.1f %10.1f %12.1f\n", name, producers, consumers,
+           items / secs, values[0] / 1e3, values[1] / 1e3, values[2] / 1e3, max / 1e3);
+    fflush(stdout);
+}
+
+/**
+ * Reads a comma separated list of positive counts.
+ *
+ * @param list   the list
+ * @param counts where to store the counts
+ * @return number of counts
+ */
+int readCounts(const char *list, int *counts)
+{
+    int n = 0;
+    for (const char *p = list; *p && n < MAX_COUNTS; p += strcspn(p, ","), p += *p == ',')
+        if (atoi(p) > 0)
+            counts[n++] = atoi(p);
+    return n;
+}
+
+/**
+ * Main program for the queue benchmark
+ * @param argc the number of arguments passed from commandline
+ * @param argv the array of strings passed from commandline
+ * @return exit status
+ */
+int main(int argc, char *argv[])
+{
+    int producerCounts[MAX_COUNTS], consumerCounts[MAX_COUNTS];
+    int numProducers = readCounts("1,2,4", producerCounts);
+    int numConsumers = readCounts("1,2,4", consumerCounts);
+    size_t capacity = CAPACITY;
+    long items = ITEMS;
+    const char *queues = "monitor,mpmc";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:c:n:i:q:")) != -1){
+        switch (opt){
+        case 'p':
+            numProducers = readCounts(optarg, producerCounts);
+            break;
+        case 'c':
+            numConsumers = readCounts(optarg, consumerCounts);
+            break;
+        case 'n':
+            capacity = strtoul(optarg, NULL, 10);
+            break;
+        case 'i':
+            items = atol(optarg);
+            break;
+        case 'q':
+            queues = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p producer counts] [-c consumer counts] [-n capacity] [-i items] [-q queues]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (numProducers == 0 || numConsumers == 0 || capacity < 1 || items < 1){
+        fprintf(stderr, "Invalid counts, capacity or items\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("capacity %zu, %ld items, latencies in microseconds\n", capacity, items);
+    printf("%-8s %3s %3s %12s %10s %10s %10s %12s\n", "queue", "P", "C", "items/s", "p50",
+           "p99", "p99.9", "max");
+    for (int i = 0; i < numProducers; i++)
+        for (int j = 0; j < numConsumers; j++){
+            if (strstr(queues, "monitor")){
+                BoundedBuffer<Item> q(capacity);
+                run("monitor", q, producerCounts[i], consumerCounts[j], items);
+            }
+            if (strstr(queues, "mpmc")){
+                MpmcQueue<Item> q(capacity);
+                run("mpmc", q, producerCounts[i], consumerCounts[j], items);
+            }
+        }
+    return EXIT_SUCCESS;
+}